@@ -0,0 +1,70 @@
+//
+//  ASTContext.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef ASTContext_hpp
+#define ASTContext_hpp
+
+#include "llvm/Support/Allocator.h"
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// ASTDeleter - AST nodes are owned by their ASTContext, the owning pointers
+/// between nodes only describe the tree and never free anything themselves.
+struct ASTDeleter {
+    void operator()(const void *) const {}
+};
+
+template <typename T>
+using ASTPtr = std::unique_ptr<T, ASTDeleter>;
+
+/// ASTContext - Bump-pointer arena holding every AST node of a compilation
+/// unit. Nodes are destroyed and their memory released together by reset().
+class ASTContext {
+    llvm::BumpPtrAllocator Allocator;
+    // Nodes still own strings, vectors and scopes, so their destructors run on reset.
+    std::vector<std::pair<void *, void (*)(void *)>> Destructors;
+    size_t NumNodes = 0;
+
+    template <typename T>
+    static void destroy(void *Node) { static_cast<T *>(Node)->~T(); }
+
+public:
+    ASTContext() {}
+    ASTContext(const ASTContext &) = delete;
+    ASTContext &operator=(const ASTContext &) = delete;
+    ~ASTContext() { reset(); }
+
+    template <typename T, typename... ArgTs>
+    ASTPtr<T> create(ArgTs &&... Args) {
+        void *Mem = Allocator.Allocate(sizeof(T), alignof(T));
+        T *Node = new (Mem) T(std::forward<ArgTs>(Args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            Destructors.push_back(std::make_pair((void *)Node, &destroy<T>));
+        NumNodes++;
+        return ASTPtr<T>(Node);
+    }
+
+    void reset() {
+        for (auto I = Destructors.rbegin(); I != Destructors.rend(); ++I)
+            I->second(I->first);
+        Destructors.clear();
+        Allocator.Reset();
+        NumNodes = 0;
+    }
+
+    /// Every node used to be a heap allocation of its own, now there is one per slab.
+    size_t getNumNodes() const { return NumNodes; }
+    size_t getNumSlabs() const { return Allocator.GetNumSlabs(); }
+    size_t getBytesAllocated() const { return Allocator.getBytesAllocated(); }
+    size_t getTotalMemory() const { return Allocator.getTotalMemory(); }
+};
+
+#endif /* ASTContext_hpp */
@@ -0,0 +1,78 @@
+//
+//  BuildSupport.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "BuildSupport.hpp"
+
+#include <iostream>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+
+using namespace std;
+using namespace llvm;
+
+bool writeFileAtomically(StringRef Path, function_ref<bool(raw_pwrite_stream &)> Write) {
+    SmallString<128> TmpPath(sys::path::parent_path(Path));
+    sys::path::append(TmpPath, "tmp-%%%%%%%%");
+    int FD;
+    if (sys::fs::createUniqueFile(TmpPath, FD, TmpPath))
+        return false;
+    bool Written;
+    {
+        raw_fd_ostream OS(FD, true);
+        Written = Write(OS);
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            Written = false;
+        }
+    }
+    if (!Written || sys::fs::rename(TmpPath, Path)) {
+        sys::fs::remove(TmpPath);
+        return false;
+    }
+    return true;
+}
+
+bool linkObjects(const vector<string> &Objects, StringRef Dir, StringRef Output) {
+    auto Ld = sys::findProgramByName("ld");
+    if (!Ld) {
+        cerr << "LogError: no ld to join the objects with" << endl;
+        return false;
+    }
+    // Too many objects for a command line go through a file.
+    SmallString<128> ListPath(Dir);
+    sys::path::append(ListPath, "objects");
+    {
+        error_code EC;
+        raw_fd_ostream List(ListPath, EC, sys::fs::OF_Text);
+        if (EC) {
+            cerr << "LogError: can't write " << ListPath.str().str() << ": " << EC.message() << endl;
+            return false;
+        }
+        for (auto &Object : Objects)
+            List << Object << "\n";
+    }
+#ifdef __APPLE__
+    string ListArg = ListPath.str().str();
+    StringRef Args[] = { "ld", "-r", "-o", Output, "-filelist", ListArg };
+#else
+    string ListArg = "@" + ListPath.str().str();
+    StringRef Args[] = { "ld", "-r", "-o", Output, ListArg };
+#endif
+    string ErrMsg;
+    int Ret = sys::ExecuteAndWait(*Ld, Args, None, {}, 0, 0, &ErrMsg);
+    sys::fs::remove(ListPath);
+    if (Ret) {
+        cerr << "LogError: can't link the objects into " << Output.str() << (ErrMsg.empty() ? "" : ": " + ErrMsg) << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,39 @@
+//
+//  BuildSupport.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef BuildSupport_hpp
+#define BuildSupport_hpp
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// PrepareFunction - Sets up a module of generated code for the target and
+/// optimizes it. Builders that prepare their items or chunks one module at a
+/// time don't inline calls from one module into another.
+using PrepareFunction = std::function<void(llvm::Module &)>;
+
+/// EmitFunction - Writes a prepared module as an object file. Returns false
+/// if it fails.
+using EmitFunction = std::function<bool(llvm::Module &, llvm::raw_pwrite_stream &)>;
+
+/// writeFileAtomically - Writes Path with Write into a file beside it and
+/// renames that in, so no reader ever sees half of it. Returns false if
+/// writing fails, nothing is left behind then.
+bool writeFileAtomically(llvm::StringRef Path, llvm::function_ref<bool(llvm::raw_pwrite_stream &)> Write);
+
+/// linkObjects - Joins Objects into Output with a relocatable link, ld -r.
+/// The list goes to ld through a file in Dir. Returns false if it fails.
+bool linkObjects(const std::vector<std::string> &Objects, llvm::StringRef Dir, llvm::StringRef Output);
+
+#endif /* BuildSupport_hpp */
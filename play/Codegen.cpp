@@ -10,10 +10,18 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "Codegen.hpp"
 #include "GlobalVars.hpp"
+#include "llvm/Support/SaveAndRestore.h"
 
 static vector<DIScope *> LexicalBlocks;
+// The interactive expression being generated, its return statements hand
+// their value to it.
+static thread_local ExprResultAST *CurrentResult = nullptr;
 
-const std::string& FunctionAST::getName() const {
+const PrototypeAST& FunctionAST::getProto() const {
+    return *Proto;
+}
+
+StringRef FunctionAST::getName() const {
     return Proto->getName();
 }
 
@@ -38,6 +46,8 @@ Value *VariableExprAST::codegen() {
 
 Value *RightValueAST::codegen() {
     auto V = Expr->codegen();
+    if (!V)
+        return nullptr;
     if (V->getType()->isPointerTy() && V->getType()->getPointerElementType()->isStructTy())
         return V;
     else if (V->getType()->isPointerTy())
@@ -45,12 +55,50 @@ Value *RightValueAST::codegen() {
     return V;
 }
 
+Value *ExprResultAST::codegen() {
+    Value *V;
+    {
+        SaveAndRestore<ExprResultAST *> InResult(CurrentResult, this);
+        V = Expr->codegen();
+    }
+    // A block ending in a return statement has returned already.
+    if (getBuilder()->GetInsertBlock()->getTerminator())
+        return V;
+    return createResult(V);
+}
+
+Value *ExprResultAST::createResult(Value *V) {
+    auto RT = getBuilder()->GetInsertBlock()->getParent()->getReturnType();
+    // Returned values of another type are printed as the first one.
+    if (V && ResultType && V->getType() != ResultType) {
+        if (ResultType->isDoubleTy() && V->getType()->isIntegerTy())
+            V = getBuilder()->CreateSIToFP(V, ResultType);
+        else if (ResultType->isIntegerTy() && V->getType()->isDoubleTy())
+            V = getBuilder()->CreateFPToSI(V, ResultType);
+        else if (ResultType->isIntegerTy() && V->getType()->isIntegerTy())
+            V = getBuilder()->CreateZExtOrTrunc(V, ResultType);
+    }
+
+    if (V && V->getType()->isIntegerTy()) {
+        ResultType = V->getType();
+        V = ResultType->isIntegerTy(1) ? getBuilder()->CreateZExt(V, RT) : getBuilder()->CreateSExtOrTrunc(V, RT);
+    } else if (V && V->getType()->isDoubleTy()) {
+        ResultType = V->getType();
+        V = getBuilder()->CreateBitCast(V, RT);
+    } else {
+        V = ConstantInt::get(RT, 0);
+    }
+    return getBuilder()->CreateRet(V);
+}
+
 Value *BinaryExprAST::codegen() {
     if (Op == tok_equal) { // assign
 
         auto LHSRV = static_cast<RightValueAST *>(LHS.get());
 
         auto LD = LHSRV->getExpr()->codegen();
+        if (!LD)
+            return nullptr;
         auto Val = RHS->codegen();
         if (!Val)
             return LogErrorV("RHS codegen return null");
@@ -115,8 +163,9 @@ Value *BinaryExprAST::codegen() {
                 return LogErrorV("Expected same type");
         default:
         {
-            auto F = TheParser->getFunction(string("binary") + Op);
-            assert(F && "binary operator not found!");
+            auto F = TheParser->getFunction(TheParser->getOperatorSymbol(true, Op));
+            if (!F)
+                return LogErrorV("binary operator not found");
             auto Ops = { L, R };
             return getBuilder()->CreateCall(F, Ops, "calltmp");
         }
@@ -125,22 +174,18 @@ Value *BinaryExprAST::codegen() {
 
 Value *MemberAccessAST::codegen() {
     auto V = Var->codegen();
+    if (!V)
+        return nullptr;
     V = getBuilder()->CreateLoad(V);
-    string StructName;
-    if (V->getType()->isPointerTy() && V->getType()->getPointerElementType()->isStructTy()) {
-        StructName = V->getType()->getPointerElementType()->getStructName();
-    } else {
+    if (!V->getType()->isPointerTy() || !V->getType()->getPointerElementType()->isStructTy())
         return LogErrorV("fail to get struct name from var");
-    }
-    auto PrefixLen = string("class.").length();
-    string ClassName = StructName.substr(PrefixLen, StructName.length() - PrefixLen);
-    auto ClsDecl = scope->getClass(ClassName);
+    auto ClsDecl = TheParser->getClassDecl(V->getType()->getPointerElementType());
     if (!ClsDecl)
-        return LogErrorV(string("Class not found: ") + ClassName);
+        return LogErrorV(string("Class not found: ") + V->getType()->getPointerElementType()->getStructName().str());
     unsigned Idx = ClsDecl->indexOfMember(Member);
     VarType VT = ClsDecl->getMember(Idx)->VType;
     auto MT = VT.getType(getContext());
-    auto ElePtr = getBuilder()->CreateStructGEP(V, Idx, string(".") + Member); // i64*
+    auto ElePtr = getBuilder()->CreateStructGEP(V, Idx, Twine(".") + Member.str()); // i64*
     if (RHS) {
         Value *RVal;
         RVal = RHS->codegen(); //i64
@@ -154,10 +199,14 @@ Value *MemberAccessAST::codegen() {
 
 Value *IndexerAST::codegen() {
     auto V = Var->codegen();
+    if (!V)
+        return nullptr;
     V = getBuilder()->CreateLoad(V);
     if (V->getType()->isPointerTy()) {
 
         auto Idx = Index->codegen();
+        if (!Idx)
+            return nullptr;
         auto ElePtr = getBuilder()->CreateGEP(V, Idx);
 
         auto EleTy = V->getType()->getPointerElementType();
@@ -177,8 +226,11 @@ Value *IndexerAST::codegen() {
 
 Value *NewAST::codegen() {
     unsigned Sizeof = Type.getMemoryBytes();
-    auto Cap = getBuilder()->CreateMul(Size->codegen(), ConstantInt::get(getContext(), APInt(64, Sizeof)));
-    auto MallocF = TheParser->getModule().getFunction("malloc");
+    auto SizeV = Size->codegen();
+    if (!SizeV)
+        return nullptr;
+    auto Cap = getBuilder()->CreateMul(SizeV, ConstantInt::get(getContext(), APInt(64, Sizeof)));
+    auto MallocF = TheParser->getFunction("malloc");
     Value *SizeArg[] = { Cap };
     auto Ptr = getBuilder()->CreateCall(MallocF, SizeArg, "ptr");
     auto ObjPtr = getBuilder()->CreateBitCast(Ptr, Type.getType(getContext())->getPointerTo(), "new");
@@ -186,8 +238,11 @@ Value *NewAST::codegen() {
 }
 
 Value *DeleteAST::codegen() {
-    auto ReleaseF = TheParser->getModule().getFunction("free");
-    getBuilder()->CreateCall(ReleaseF, Var->codegen());
+    auto ReleaseF = TheParser->getFunction("free");
+    auto V = Var->codegen();
+    if (!V)
+        return nullptr;
+    getBuilder()->CreateCall(ReleaseF, V);
     return Constant::getNullValue(Type::getVoidTy(getContext()));
 }
 
@@ -198,6 +253,10 @@ Value *ReturnAST::codegen() {
         return getBuilder()->CreateRetVoid();
 
     auto RV = Var->codegen();
+    if (!RV)
+        return nullptr;
+    if (CurrentResult)
+        return CurrentResult->createResult(RV);
     switch (RT->getTypeID()) {
         case llvm::Type::IntegerTyID:
             if (RV->getType()->isIntegerTy()) {
@@ -272,7 +331,7 @@ Value *ForExprAST::codegen() {
     if (!StartVal)
         return nullptr;
 
-    auto Alloca = getScope()->getVal(Var->getName());
+    auto Alloca = getScope()->getVal(Var->getSymbol());
 
     auto TestBlock = BasicBlock::Create(getContext(), "test", F);
     auto LoopBlock = BasicBlock::Create(getContext(), "loop", F);
@@ -322,6 +381,8 @@ Value *VarExprAST::codegen() {
     Value *InitVal;
     if (Init) {
         InitVal = Init->codegen();
+        if (!InitVal)
+            return nullptr;
 //        scope->setVal(Name, InitVal);
 //        return InitVal;
     } else {
@@ -356,7 +417,7 @@ Value *UnaryExprAST::codegen() {
             break;
     }
 
-    auto F = TheParser->getFunction(string("unary") + Opcode);
+    auto F = TheParser->getFunction(TheParser->getOperatorSymbol(false, Opcode));
     if (!F)
         return LogErrorV("Unkown unary operator");
 
@@ -378,11 +439,11 @@ Value *CallExprAST::codegen() {
     if (!CalleeF) {
         auto ClassType = scope->getClassType(Callee);
         if (!ClassType)
-            return LogErrorV((string("Unknown function referenced ") + Callee));
+            return LogErrorV((string("Unknown function referenced ") + Callee.c_str()));
 
         // %ptr = malloc()
         auto Bytes = scope->getClass(Callee)->getMemoryBytes();
-        auto MallocF = TheParser->getModule().getFunction("malloc");
+        auto MallocF = TheParser->getFunction("malloc");
         Value *SizeArg[] = {ConstantInt::get(Type::getInt64Ty(getContext()), Bytes)};
         auto Ptr = getBuilder()->CreateCall(MallocF, SizeArg, "ptr");
 
@@ -412,15 +473,15 @@ Value *CallExprAST::codegen() {
 
 Value * MethodCallAST::codegen() {
     auto V = Var->codegen();
+    if (!V)
+        return nullptr;
     V = getBuilder()->CreateLoad(V);
-    string StructName = V->getType()->getPointerElementType()->getStructName();
-    auto PrefixLen = string("class.").length();
-    string ClassName = StructName.substr(PrefixLen, StructName.length() - PrefixLen);
-    string Fn = ClassName + "$" + Callee;
+    auto ClsDecl = TheParser->getClassDecl(V->getType()->getPointerElementType());
+    Symbol Fn = ClsDecl ? ClsDecl->getMethodSymbol(Callee) : Symbol();
     // Look up the name in the global module table.
-    Function *CalleeF = TheParser->getFunction(Fn);
+    Function *CalleeF = Fn.isValid() ? TheParser->getFunction(Fn) : nullptr;
     if (!CalleeF) {
-        return LogErrorV(string("method not found: ") + Callee);
+        return LogErrorV(string("method not found: ") + Callee.c_str());
     }
 
     // If argument mismatch error.
@@ -446,7 +507,7 @@ Function *PrototypeAST::codegen() {
     }
     Type *TheRetType = RetType.getType(getContext());
     FunctionType *FT = FunctionType::get(TheRetType, ArgTypes, false);
-    Function *F = Function::Create(FT, Function::ExternalLinkage, Name, TheParser->getModule());
+    Function *F = Function::Create(FT, Function::ExternalLinkage, Name.str(), TheParser->getModule());
     unsigned long Idx = 0;
     for (auto &Arg : F->args())
         Arg.setName(Args[Idx++]->getName());
@@ -454,10 +515,16 @@ Function *PrototypeAST::codegen() {
 }
 
 Function *FunctionAST::codegen() {
+    // The parser stepped over the body, there is only the prototype to declare.
+    if (!Body) {
+        declare();
+        return nullptr;
+    }
     auto &P = *Proto;
-    cout << "codegen: " << P.getName() << endl;
+    DLog(DLT_IR, string("codegen: ") + P.getName().str());
+    TimePhase Phase("irgen", "IR generation", P.getName());
     TheParser->AddFunctionProtos(std::move(Proto));
-    Function *F = TheParser->getFunction(P.getName());
+    Function *F = TheParser->getFunction(P.getSymbol());
     if (!F)
         return nullptr;
 
@@ -471,6 +538,7 @@ Function *FunctionAST::codegen() {
     // location in a function are considered part of the prologue and the debugger
     // will run past them when breaking on a function)
 
+    unsigned ArgNo = 0;
     for (auto &Arg : F->args()) {
         auto ArgTy = Arg.getType();
 //        Body->getScope()->setVal(Arg.getName(), &Arg);
@@ -488,7 +556,7 @@ Function *FunctionAST::codegen() {
         // arg type
         getBuilder()->CreateStore(&Arg, Alloca);
 //        auto ArgLocal = getBuilder()->CreateLoad(Alloca);
-        Body->getScope()->setVal(Arg.getName(), Alloca);
+        Body->getScope()->setVal(P.getArgSymbol(ArgNo++), Alloca);
     }
 
     Body->codegen();
@@ -497,21 +565,43 @@ Function *FunctionAST::codegen() {
         getBuilder()->CreateRetVoid();
     }
 
-    verifyFunction(*F);
+    Phase.end();
+
+    // Only clean up well-formed functions, the passes assume valid IR.
+    if (!verifyFunction(*F))
+        TheParser->RunFunction(F);
 
     return F;
 }
 
+void FunctionAST::declare() {
+    auto &P = *Proto;
+    TheParser->AddFunctionProtos(std::move(Proto));
+    if (P.isBinaryOp())
+        TheParser->SetBinOpPrecedence(P.getOperatorName(), P.getBinaryPrecedence());
+}
+
 StructType * ClassDeclAST::codegen() {
+    auto ST = createType();
+    for (auto E = Methods.begin(); E != Methods.end(); E ++)
+        (*E)->codegen();
+    return ST;
+}
+
+StructType * ClassDeclAST::declare() {
+    auto ST = createType();
+    for (auto E = Methods.begin(); E != Methods.end(); E ++)
+        (*E)->declare();
+    return ST;
+}
+
+StructType * ClassDeclAST::createType() {
     vector<Type *> Tys;
     for (auto E = Members.begin(); E != Members.end(); E ++) {
         Tys.push_back((*E)->VType.getType(getContext()));
     }
-    auto ST = StructType::create(getContext(), Tys, string("class") + "." + Name, false);
+    auto ST = StructType::create(getContext(), Tys, string("class.") + Name.c_str(), false);
     scope->setClassType(Name, ST);
-
-    for (auto E = Methods.begin(); E != Methods.end(); E ++)
-        (*E)->codegen();
-
+    TheParser->AddClassDecl(ST, this);
     return ST;
 }
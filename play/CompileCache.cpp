@@ -0,0 +1,180 @@
+//
+//  CompileCache.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "CompileCache.hpp"
+#include "BuildSupport.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <sys/time.h>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+
+using namespace std;
+using namespace llvm;
+
+struct CacheEntry {
+    string Path;
+    uint64_t Size;
+    sys::TimePoint<> LastUsed;
+};
+
+/// listEntries - Every object in Dir, the least recently used first.
+static vector<CacheEntry> listEntries(StringRef Dir) {
+    vector<CacheEntry> Entries;
+    error_code EC;
+    for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC; I.increment(EC)) {
+        if (sys::path::extension(I->path()) != ".o")
+            continue;
+        sys::fs::file_status Status;
+        if (sys::fs::status(I->path(), Status))
+            continue;
+        Entries.push_back({ I->path(), Status.getSize(), Status.getLastModificationTime() });
+    }
+    std::sort(Entries.begin(), Entries.end(),
+         [](const CacheEntry &A, const CacheEntry &B) { return A.LastUsed < B.LastUsed; });
+    return Entries;
+}
+
+/// readTotals - Hits, misses and evictions of earlier runs.
+static void readTotals(StringRef Path, uint64_t Totals[3]) {
+    Totals[0] = Totals[1] = Totals[2] = 0;
+    auto Buf = MemoryBuffer::getFile(Path);
+    if (!Buf)
+        return;
+    SmallVector<StringRef, 3> Fields;
+    (*Buf)->getBuffer().trim().split(Fields, ' ');
+    for (size_t i = 0; i < Fields.size() && i < 3; i++)
+        Fields[i].getAsInteger(10, Totals[i]);
+}
+
+CompileCache::CompileCache(StringRef dir, uint64_t maxBytes): Dir(dir), MaxBytes(maxBytes) {
+    if (Dir.empty()) {
+        SmallString<128> Path;
+        // Where ccache keeps its objects, or the temp directory without a home.
+        if (sys::path::home_directory(Path)) {
+            sys::path::append(Path, ".cache", "playc");
+        } else {
+            sys::path::system_temp_directory(true, Path);
+            sys::path::append(Path, "playc-cache");
+        }
+        Dir = Path.str().str();
+    }
+    if (auto EC = sys::fs::create_directories(Dir))
+        cerr << "LogError: can't create cache directory " << Dir << ": " << EC.message() << endl;
+}
+
+string CompileCache::getKey(ArrayRef<StringRef> Parts) {
+    SHA1 Hash;
+    auto AddPart = [&](StringRef Part) {
+        // Sized, so no two lists of parts hash the same bytes.
+        uint8_t Size[8];
+        support::endian::write64le(Size, Part.size());
+        Hash.update(ArrayRef<uint8_t>(Size));
+        Hash.update(Part);
+    };
+
+    string Exe = sys::fs::getMainExecutable(nullptr, (void *)(intptr_t)&listEntries);
+    sys::fs::file_status Status;
+    if (!sys::fs::status(Exe, Status)) {
+        AddPart(Exe);
+        AddPart(to_string(Status.getSize()));
+        AddPart(to_string(sys::toTimeT(Status.getLastModificationTime())));
+    }
+    for (auto Part : Parts)
+        AddPart(Part);
+    return toHex(Hash.result(), true);
+}
+
+string CompileCache::getEntryPath(StringRef Key) const {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Key + ".o");
+    return Path.str().str();
+}
+
+bool CompileCache::lookup(StringRef Key, StringRef Path) {
+    auto Entry = getEntryPath(Key);
+    if (!sys::fs::exists(Entry) || sys::fs::copy_file(Entry, Path)) {
+        Misses++;
+        return false;
+    }
+    // The modification time orders the eviction, a hit makes it recent again.
+    utimes(Entry.c_str(), nullptr);
+    Hits++;
+    return true;
+}
+
+void CompileCache::store(StringRef Key, StringRef Path) {
+    auto Object = MemoryBuffer::getFile(Path);
+    if (!Object)
+        return;
+    // Another compiler may look the entry up meanwhile.
+    if (!writeFileAtomically(getEntryPath(Key), [&](raw_pwrite_stream &OS) {
+            OS << (*Object)->getBuffer();
+            return true;
+        }))
+        return;
+    prune();
+}
+
+void CompileCache::prune() {
+    auto Entries = listEntries(Dir);
+    uint64_t Total = 0;
+    for (auto &E : Entries)
+        Total += E.Size;
+    for (auto &E : Entries) {
+        if (Total <= MaxBytes)
+            break;
+        if (sys::fs::remove(E.Path))
+            continue;
+        Total -= E.Size;
+        Evictions++;
+    }
+}
+
+void CompileCache::saveStats() {
+    if (!Hits && !Misses && !Evictions)
+        return;
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, "stats");
+    uint64_t Totals[3];
+    readTotals(Path, Totals);
+
+    // Concurrent compiles may lose each other's counts, never the file.
+    writeFileAtomically(Path, [&](raw_pwrite_stream &OS) {
+        OS << Totals[0] + Hits << " " << Totals[1] + Misses << " " << Totals[2] + Evictions << "\n";
+        return true;
+    });
+}
+
+void CompileCache::printStats(raw_ostream &OS) const {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, "stats");
+    uint64_t Totals[3];
+    readTotals(Path, Totals);
+
+    auto Entries = listEntries(Dir);
+    uint64_t Size = 0;
+    for (auto &E : Entries)
+        Size += E.Size;
+
+    OS << "### Object Cache Stats ###\n";
+    OS << "hits: " << Hits << ", misses: " << Misses << ", evictions: " << Evictions << "\n";
+    OS << "all runs: " << Totals[0] + Hits << " hits, " << Totals[1] + Misses << " misses, "
+       << Totals[2] + Evictions << " evictions\n";
+    OS << Dir << ": " << Entries.size() << " objects, " << Size / 1024 << " of " << MaxBytes / 1024 << " KB\n";
+}
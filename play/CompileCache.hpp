@@ -0,0 +1,56 @@
+//
+//  CompileCache.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef CompileCache_hpp
+#define CompileCache_hpp
+
+#include <cstdint>
+#include <string>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// CompileCache - Object files on disk, named by a hash of everything that went
+/// into them. A hit is copied out without lexing, parsing or generating any
+/// code. Once the cache grows past its limit, the entries used longest ago
+/// are evicted. Hits, misses and evictions add up across runs in a stats file
+/// next to the entries.
+class CompileCache {
+    std::string Dir;
+    uint64_t MaxBytes;
+    unsigned Hits = 0;
+    unsigned Misses = 0;
+    unsigned Evictions = 0;
+
+    std::string getEntryPath(llvm::StringRef Key) const;
+    void prune();
+    void saveStats();
+
+public:
+    static const uint64_t DefaultMaxBytes = 256 << 20;
+
+    /// An empty Dir means ~/.cache/playc.
+    CompileCache(llvm::StringRef Dir, uint64_t MaxBytes = DefaultMaxBytes);
+    ~CompileCache() { saveStats(); }
+
+    /// getKey - Hash of Parts and the compiler binary, a rebuilt compiler
+    /// never sees objects of the old one.
+    static std::string getKey(llvm::ArrayRef<llvm::StringRef> Parts);
+
+    /// lookup - Copies the object for Key to Path. Returns false on a miss.
+    bool lookup(llvm::StringRef Key, llvm::StringRef Path);
+
+    /// store - Adds the object at Path under Key, then evicts down to the limit.
+    void store(llvm::StringRef Key, llvm::StringRef Path);
+
+    /// printStats - This run's counts, then the totals and size on disk.
+    void printStats(llvm::raw_ostream &OS) const;
+};
+
+#endif /* CompileCache_hpp */
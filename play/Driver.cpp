@@ -6,108 +6,1006 @@
 //  Copyright © 2020 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
 //
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <sys/resource.h>
 
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/StringSaver.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Passes/PassBuilder.h"
 
 #include "GlobalVars.hpp"
+#include "Timing.hpp"
 #include "Lexer.hpp"
 #include "Parser.hpp"
 #include "Codegen.hpp"
 #include "Driver.hpp"
+#include "JIT.hpp"
+#include "Tiered.hpp"
+#include "CompileCache.hpp"
+#include "Incremental.hpp"
+#include "Lazy.hpp"
+#include "Parallel.hpp"
+#include "Pipeline.hpp"
+#include "Streaming.hpp"
+#include "WorkPool.hpp"
 
 using namespace std;
 using namespace llvm;
 
+// Owns TheParser of the compiling thread, the last one is kept until the next compile.
+static thread_local unique_ptr<Parser> MainParser;
+
+/// HandleTopLevel - Parses and generates one top level item.
+static void HandleTopLevel(Scope *scope) {
+    DLog(DLT_TOK, string("CurTok: ") + tok_tos(TheParser->getCurToken()));
+    switch (TheParser->getCurToken()) {
+        case tok_colon:
+        case tok_right_bracket:
+            TheParser->getNextToken();
+            break;
+        case tok_class:
+        case tok_type_void:
+        case tok_type_bool:
+        case tok_type_int:
+        case tok_type_float:
+        case tok_type_string:
+        case tok_type_object:
+            TheParser->HandleDefinition(scope);
+            break;
+        case tok_extern:
+            TheParser->HandleExtern(scope);
+            break;
+        default:
+            TheParser->HandleTopLevelExpression(scope);
+            break;
+    }
+}
+
 static int MainLoop() {
-    auto scope = make_shared<Scope>();
-    while (true) {
-        DLog(DLT_TOK, string("CurTok: ") + tok_tos(TheParser->getCurToken()));
-        switch (TheParser->getCurToken()) {
-            case tok_eof:
-                return 0;
-            case tok_colon:
-            case tok_right_bracket:
-                TheParser->getNextToken();
-                break;
-            case tok_class:
-            case tok_type_void:
-            case tok_type_bool:
-            case tok_type_int:
-            case tok_type_float:
-            case tok_type_string:
-            case tok_type_object:
-                TheParser->HandleDefinition(scope);
-                break;
-            case tok_extern:
-                TheParser->HandleExtern(scope);
-                break;
-            default:
-                TheParser->HandleTopLevelExpression(scope);
+    auto scope = TheParser->NewScope(nullptr);
+    while (TheParser->getCurToken() != tok_eof)
+        HandleTopLevel(scope);
+    return 0;
+}
+
+static long getPeakRSSKB() {
+    struct rusage Usage;
+    getrusage(RUSAGE_SELF, &Usage);
+#ifdef __APPLE__
+    return Usage.ru_maxrss / 1024;
+#else
+    return Usage.ru_maxrss;
+#endif
+}
+
+static void PrintASTStats(ASTContext &Ctx) {
+    cout << "### AST Stats ###" << endl;
+    cout << "nodes: " << Ctx.getNumNodes()
+         << ", slabs: " << Ctx.getNumSlabs()
+         << ", bytes: " << Ctx.getBytesAllocated()
+         << ", reserved: " << Ctx.getTotalMemory() << endl;
+    // Only the nodes themselves, the vectors of children still allocate on their own.
+    cout << "node allocations avoided: " << (long)Ctx.getNumNodes() - (long)Ctx.getNumSlabs() << endl;
+}
+
+static CodeGenOpt::Level getCodeGenOptLevel(unsigned OptLevel) {
+    switch (OptLevel) {
+        case 0: return CodeGenOpt::None;
+        case 1: return CodeGenOpt::Less;
+        case 2: return CodeGenOpt::Default;
+        default: return CodeGenOpt::Aggressive;
+    }
+}
+
+// opts["cpu"] is a CPU name or "native" for the host, opts["features"] is an
+// -mattr style list like "+avx2,-bmi" applied on top of the CPU's features.
+static void getTargetCPUAndFeatures(std::map<string, string> &opts, string &CPU, string &Features) {
+    CPU = opts.find("cpu") != opts.end() ? opts["cpu"] : "generic";
+
+    SubtargetFeatures SF;
+    if (CPU == "native") {
+        CPU = sys::getHostCPUName().str();
+        StringMap<bool> HostFeatures;
+        if (sys::getHostCPUFeatures(HostFeatures)) {
+            for (auto &F : HostFeatures)
+                SF.AddFeature(F.first(), F.second);
+        }
+    }
+    if (opts.find("features") != opts.end()) {
+        SmallVector<StringRef, 8> Attrs;
+        StringRef(opts["features"]).split(Attrs, ",", -1, false);
+        for (auto &A : Attrs)
+            SF.AddFeature(A);
+    }
+    Features = SF.getString();
+}
+
+static PipelineTuningOptions getTuningOptions(unsigned OptLevel) {
+    PipelineTuningOptions PTO;
+    PTO.LoopUnrolling = true;
+    PTO.LoopInterleaving = true;
+    PTO.LoopVectorization = OptLevel > 1;
+    PTO.SLPVectorization = OptLevel > 1;
+    return PTO;
+}
+
+/// OptPipeline - The module pipeline for one target machine and level. It is
+/// built once and run on every module after that, the analysis managers are
+/// cleared after each run so no result outlives its module.
+struct OptPipeline {
+    PassBuilder PB;
+    LoopAnalysisManager LAM;
+    FunctionAnalysisManager FAM;
+    CGSCCAnalysisManager CGAM;
+    ModuleAnalysisManager MAM;
+    ModulePassManager MPM;
+
+    OptPipeline(TargetMachine *TM, unsigned OptLevel, PassInstrumentationCallbacks *PIC)
+    : PB(TM, getTuningOptions(OptLevel), None, PIC) {
+        PB.registerModuleAnalyses(MAM);
+        PB.registerCGSCCAnalyses(CGAM);
+        PB.registerFunctionAnalyses(FAM);
+        PB.registerLoopAnalyses(LAM);
+        PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+        auto Level = OptLevel == 1 ? PassBuilder::O1 : OptLevel == 2 ? PassBuilder::O2 : PassBuilder::O3;
+        MPM = PB.buildPerModuleDefaultPipeline(Level);
+    }
+
+    void run(Module &M) {
+        MPM.run(M, MAM);
+        MAM.clear();
+        CGAM.clear();
+        FAM.clear();
+        LAM.clear();
+    }
+};
+
+static void OptimizeModule(Module &M, TargetMachine *TM, unsigned OptLevel) {
+    if (OptLevel == 0)
+        return;
+
+    // The pipeline assumes well-formed IR, leave a broken module as it is.
+    if (verifyModule(M, &ErrStream()))
+        return;
+
+    TimePhase Phase("opt", "Module optimization");
+    // One set per thread, the JIT threads and batch workers optimize side by side.
+    static thread_local std::map<std::tuple<TargetMachine *, unsigned, PassInstrumentationCallbacks *>, unique_ptr<OptPipeline>> Pipelines;
+    auto *PIC = getPassInstrumentation();
+    auto &Pipeline = Pipelines[std::make_tuple(TM, OptLevel, PIC)];
+    if (!Pipeline)
+        Pipeline = make_unique<OptPipeline>(TM, OptLevel, PIC);
+    Pipeline->run(M);
+}
+
+/// RunJIT - Runs FuncName in process through the lazy JIT and returns its
+/// result, as lli does. The parser's module is handed over to the JIT.
+static int RunJIT(const string &FuncName, unsigned OptLevel, const string &CPU, const string &Features) {
+    auto *Main = TheParser->getModule().getFunction(FuncName);
+    if (!Main || Main->isDeclaration() || Main->arg_size()) {
+        cerr << "LogError: no " << FuncName << "() to run" << endl;
+        return 1;
+    }
+    auto *RetTy = Main->getReturnType();
+
+    auto JIT = PlayJIT::Create(CPU, Features, getCodeGenOptLevel(OptLevel), [OptLevel](Module &M, TargetMachine &TM) {
+        OptimizeModule(M, &TM, OptLevel);
+    });
+    if (!JIT)
+        return 1;
+
+    TheParser->getModule().setDataLayout(JIT->getDataLayout());
+    if (!JIT->addModule(orc::ThreadSafeModule(TheParser->takeModule(), TheParser->getThreadSafeContext())))
+        return 1;
+
+    auto Addr = JIT->lookup(FuncName);
+    if (!Addr)
+        return 1;
+
+    TimePhase Phase("run", "JIT run");
+    if (RetTy->isDoubleTy())
+        return (int)((double (*)())Addr)();
+    // Only the low bit of an i1 is defined, the rest of the register isn't.
+    if (RetTy->isIntegerTy(1))
+        return ((bool (*)())Addr)() ? 1 : 0;
+    if (RetTy->isVoidTy()) {
+        ((void (*)())Addr)();
+        return 0;
+    }
+    return (int)((long (*)())Addr)();
+}
+
+static void InitializeTarget() {
+    // Once, even when the compile server's workers get here together.
+    static bool Initialized = [] {
+        LLVMInitializeX86TargetInfo();
+        LLVMInitializeX86Target();
+        LLVMInitializeX86TargetMC();
+        LLVMInitializeX86AsmParser();
+        LLVMInitializeX86AsmPrinter();
+        return true;
+    }();
+    (void)Initialized;
+}
+
+/// createTargetMachine - Returns nullptr if the target isn't registered.
+static unique_ptr<TargetMachine> createTargetMachine(const string &TargetTriple, const string &CPU,
+                                                     const string &Features, unsigned OptLevel) {
+    string Error;
+    auto Target = TargetRegistry::lookupTarget(TargetTriple, Error);
+    if (!Target) {
+        LogError(Error.c_str());
+        return nullptr;
+    }
+
+    TargetOptions opt;
+    auto RM = Optional<Reloc::Model>();
+    return unique_ptr<TargetMachine>(Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM,
+                                                                 None, getCodeGenOptLevel(OptLevel)));
+}
+
+/// getTargetMachine - Target machines are created once per triple, CPU,
+/// features and level and reused by later compiles, a compile server pays
+/// for each only once. Each thread has machines of its own.
+static TargetMachine *getTargetMachine(const string &TargetTriple, const string &CPU, const string &Features,
+                                       unsigned OptLevel) {
+    static thread_local StringMap<unique_ptr<TargetMachine>> TargetMachines;
+    auto &TM = TargetMachines[TargetTriple + " " + CPU + " " + Features + " " + to_string(OptLevel)];
+    if (!TM)
+        TM = createTargetMachine(TargetTriple, CPU, Features, OptLevel);
+    return TM.get();
+}
+
+// Let the vectorizers and the code generator see the selected target on every function.
+static void SetTargetAttributes(Module &M, const string &CPU, const string &Features) {
+    for (auto &F : M) {
+        if (F.isDeclaration())
+            continue;
+        F.addFnAttr("target-cpu", CPU);
+        if (!Features.empty())
+            F.addFnAttr("target-features", Features);
+    }
+}
+
+/// SetModuleTarget - Sets up M to be compiled by TM.
+static void SetModuleTarget(Module &M, TargetMachine *TM) {
+    M.setTargetTriple(TM->getTargetTriple().str());
+    M.setDataLayout(TM->createDataLayout());
+    SetTargetAttributes(M, TM->getTargetCPU().str(), TM->getTargetFeatureString().str());
+}
+
+/// PrepareModule - Sets up M to be compiled by TM and optimizes it.
+static void PrepareModule(Module &M, TargetMachine *TM, unsigned OptLevel) {
+    SetModuleTarget(M, TM);
+    OptimizeModule(M, TM, OptLevel);
+}
+
+/// EmitObject - Writes M to OS as an object file for TM.
+static bool EmitObject(TargetMachine *TM, Module &M, raw_pwrite_stream &OS) {
+    legacy::PassManager Pass;
+    if (TM->addPassesToEmitFile(Pass, OS, nullptr, llvm::TargetMachine::CGFT_ObjectFile)) {
+        LogError("TheTargetMachine can't emit a file of this type");
+        return false;
+    }
+    Pass.run(M);
+    return true;
+}
+
+/// RunTiered - Runs the parsed program starting at FuncName, interpreting
+/// functions until they turn hot. Returns FuncName's result.
+static int RunTiered(TieredRuntime &Runtime, const string &FuncName, bool PrintStats) {
+    if (!Runtime.start())
+        return 1;
+    auto *Main = Runtime.getFunction(TheParser->getSymbols().lookup(FuncName));
+    if (!Main || !Main->Scalar || Main->ArgTypes.size()) {
+        cerr << "LogError: no " << FuncName << "() to run" << endl;
+        return 1;
+    }
+
+    InterpValue Ret;
+    {
+        TimePhase Phase("run", "Tiered run");
+        Ret = Runtime.call(*Main, {});
+    }
+    Runtime.stop();
+    if (PrintStats) {
+        Runtime.printStats(OutStream());
+        OutStream().flush();
+    }
+    return (int)Ret.convertTo(VarType(VarTypeInt)).I;
+}
+
+/// RunShards - Lexes the source once, then parses it on NumShards threads,
+/// each generating and optimizing its share of the top level items in a
+/// context of its own and stepping over the bodies of the rest. The items are
+/// linked into the module of TheParser. NumTokens and NumNodes are set to the
+/// tokens lexed and the AST nodes the shards built. Returns false on errors.
+static bool RunShards(const vector<StringRef> &Buffers, const string &Filename, std::string &TopFuncName,
+                      unsigned OptLevel, unsigned NumShards, std::map<string, string> &opts, size_t &NumTokens,
+                      size_t &NumNodes) {
+    string TargetTriple = sys::getDefaultTargetTriple(), CPU, Features;
+    getTargetCPUAndFeatures(opts, CPU, Features);
+
+    SkimmedTokens Skimmed;
+    {
+        TimePhase Phase("skim", "Skim tokens");
+        Skimmed = SkimmedTokens::skim(Buffers);
+    }
+
+    vector<vector<ShardItem>> Items(NumShards);
+    vector<char> Failed(NumShards, 1);
+    vector<size_t> Nodes(NumShards);
+    auto RunShard = [&](unsigned Shard) {
+        // Neither the target machine nor the pipeline can be shared between threads.
+        auto TM = createTargetMachine(TargetTriple, CPU, Features, OptLevel);
+        if (!TM)
+            return;
+        unique_ptr<OptPipeline> Pipeline;
+        if (OptLevel > 0)
+            Pipeline = std::make_unique<OptPipeline>(TM.get(), OptLevel, getPassInstrumentation());
+
+        Parser P(Buffers, Filename, OptLevel, nullptr, &Skimmed);
+        P.SetTopFuncName(TopFuncName);
+        TheParser = &P;
+        ShardBuild Build(Shard, NumShards, [&](Module &M) {
+            SetModuleTarget(M, TM.get());
+            if (Pipeline) {
+                TimePhase Phase("opt", "Module optimization");
+                Pipeline->run(M);
+            }
+        });
+        P.SetItemBuilder(&Build);
+        unsigned Errors = NumErrors();
+        MainLoop();
+        TheParser = nullptr;
+
+        Nodes[Shard] = P.getASTContext().getNumNodes();
+        Items[Shard] = Build.takeItems();
+        Failed[Shard] = Build.failed() || NumErrors() != Errors;
+    };
+
+    // The calling thread takes the first shard, its phases show in -time-report.
+    auto *Main = TheParser;
+    vector<std::thread> Threads;
+    for (unsigned i = 1; i < NumShards; i++)
+        Threads.emplace_back(RunShard, i);
+    RunShard(0);
+    for (auto &T : Threads)
+        T.join();
+    TheParser = Main;
+
+    // Every shard reads all the tokens, they were lexed once.
+    NumTokens = Skimmed.Tokens.size();
+    NumNodes = std::accumulate(Nodes.begin(), Nodes.end(), (size_t)0);
+    if (find(Failed.begin(), Failed.end(), 1) != Failed.end())
+        return false;
+    TimePhase Phase("link", "Link items");
+    return linkShardItems(Items, TheParser->getModule());
+}
+
+/// RunPipeline - Lexes the source on one thread, parses and generates IR on
+/// the calling thread, and optimizes each item on a third, with bounded
+/// queues between them. The items are linked into the module of TheParser.
+/// NumTokens and NumNodes are set to the parser's counts. Returns false on
+/// errors.
+static bool RunPipeline(const vector<StringRef> &Buffers, const string &Filename, std::string &TopFuncName,
+                        unsigned OptLevel, std::map<string, string> &opts, bool PrintStats, size_t &NumTokens,
+                        size_t &NumNodes) {
+    string TargetTriple = sys::getDefaultTargetTriple(), CPU, Features;
+    getTargetCPUAndFeatures(opts, CPU, Features);
+
+    // Tokens point into the buffers, which outlive every stage.
+    SPSCQueue<TokenInfo> Tokens(4096);
+    std::thread LexThread([&] {
+        Lexer L(Buffers);
+        do {
+            L.getNextToken();
+            Tokens.push(L.getCurTokenInfo());
+        } while (L.getCurToken() != tok_eof);
+    });
+
+    SPSCQueue<ShardItem> Items(64);
+    vector<vector<ShardItem>> Optimized(1);
+    bool BackEndFailed = false;
+    std::thread BackEnd([&] {
+        // A context of its own, the parser keeps generating into the other one.
+        LLVMContext Context;
+        auto *TM = getTargetMachine(TargetTriple, CPU, Features, OptLevel);
+        BackEndFailed = !TM;
+        while (true) {
+            auto Item = Items.pop();
+            if (Item.Bitcode.empty())
                 break;
+            if (BackEndFailed)
+                continue;
+            MemoryBufferRef Buf(StringRef(Item.Bitcode.data(), Item.Bitcode.size()), Filename);
+            auto M = parseBitcodeFile(Buf, Context);
+            if (!M) {
+                logAllUnhandledErrors(M.takeError(), ErrStream(), "LogError: ");
+                BackEndFailed = true;
+                continue;
+            }
+            PrepareModule(**M, TM, OptLevel);
+            Item.Bitcode.clear();
+            raw_svector_ostream OS(Item.Bitcode);
+            WriteBitcodeToFile(**M, OS);
+            Optimized[0].push_back(std::move(Item));
         }
+    });
+
+    auto *Main = TheParser;
+    bool Failed;
+    {
+        Parser P(Buffers, Filename, OptLevel, &Tokens);
+        P.SetTopFuncName(TopFuncName);
+        TheParser = &P;
+        PipelineBuild Build(Items);
+        P.SetItemBuilder(&Build);
+        MainLoop();
+        Build.finish();
+        Failed = Build.failed();
+        NumTokens = P.getNumTokens();
+        NumNodes = P.getASTContext().getNumNodes();
+        TheParser = Main;
+    }
+    LexThread.join();
+    BackEnd.join();
+
+    if (PrintStats) {
+        OutStream() << "### Pipeline Stats ###\n";
+        OutStream() << "lexer waits: " << Tokens.getNumFullWaits() << ", parser waits for tokens: "
+               << Tokens.getNumEmptyWaits() << ", parser waits for the back end: " << Items.getNumFullWaits()
+               << ", back end waits: " << Items.getNumEmptyWaits() << "\n";
+    }
+    if (Failed || BackEndFailed)
+        return false;
+    TimePhase Phase("link", "Link items");
+    return linkShardItems(Optimized, TheParser->getModule());
+}
+
+// Runtime functions every program may call, lexed as a buffer of its own ahead of the source.
+static const char Prelude[] = "extern int *malloc(int x);"
+                              "extern void free(int *);";
+
+/// getCacheKey - Everything the object file depends on: the source, the
+/// prelude, the target and the options that change the generated code.
+static string getCacheKey(StringRef Source, std::map<string, string> &opts) {
+    string TargetTriple = sys::getDefaultTargetTriple(), CPU, Features;
+    getTargetCPUAndFeatures(opts, CPU, Features);
+
+    // Output names and reports leave the object as it is.
+    static const char *const Ignored[] = { "out", "trace", "trace-file", "time-report", "time-trace", "stats",
+                                           "cache", "cache-size", "incremental", "threads", "stream",
+                                           "pipeline" };
+    string Options;
+    for (auto &O : opts) {
+        if (!O.second.empty() && find(begin(Ignored), end(Ignored), O.first) == end(Ignored))
+            Options += O.first + "=" + O.second + "\n";
     }
+    // Items optimized one by one make other code than the whole module, the
+    // same for any number of threads.
+    bool ByItem = opts.find("incremental") != opts.end() || opts.find("threads") != opts.end() ||
+                  opts.find("stream") != opts.end() || opts.find("pipeline") != opts.end();
+    StringRef Parts[] = { Source, StringRef(Prelude, sizeof(Prelude) - 1), TargetTriple, CPU, Features,
+                          Options, ByItem ? "items" : "module" };
+    return CompileCache::getKey(Parts);
+}
+
+// Batch workers print their lines whole.
+static std::mutex OutputLock;
+
+static void PrintWrote(const string &Filename) {
+    lock_guard<std::mutex> Lock(OutputLock);
+    cout << "Wrote " << Filename << endl;
 }
 
-int compile(std::string &filename, std::string &src, std::map<string, string> &opts)
+/// CompileSource - One compile on the calling thread, after traces and
+/// timers are set up for the process.
+static int CompileSource(std::string &filename, SourceBuffer &src, std::map<string, string> &opts,
+                         CompileStats *Stats)
 {
-    src = string("extern int *malloc(int x);")
-          + string("extern void free(int *);")
-          + src;
+    bool TimeTrace = opts.find("time-trace") != opts.end();
+    CollectPhaseTimes(Stats ? &Stats->PhaseSeconds : nullptr);
+    auto StopCollecting = make_scope_exit([] { CollectPhaseTimes(nullptr); });
+    DLog(DLT_SRC, src.getBuffer());
 
-    cout << src << endl;
+    unsigned OptLevel = opts.find("O") != opts.end() ? (unsigned)atoi(opts["O"].c_str()) : 0;
+    if (OptLevel > 3)
+        OptLevel = 3;
 
+    auto Filename = opts.find("out") != opts.end() ? opts["out"] : "output.o";
+    bool PrintStats = opts.find("stats") != opts.end();
+
+    unique_ptr<CompileCache> Cache;
+    string CacheKey;
+    if (opts.find("cache") != opts.end() && opts["jit"] != "1" && opts["tiered"] != "1") {
+        uint64_t MaxBytes = CompileCache::DefaultMaxBytes;
+        if (opts.find("cache-size") != opts.end())
+            MaxBytes = (uint64_t)atoll(opts["cache-size"].c_str()) << 20;
+        Cache = std::make_unique<CompileCache>(opts["cache"], MaxBytes);
+        CacheKey = getCacheKey(src.getBuffer(), opts);
+        // A hit compiles nothing, so there would be no times to report.
+        if (!TimeTrace && !isTimeReportEnabled() && Cache->lookup(CacheKey, Filename)) {
+            PrintWrote(Filename);
+            if (PrintStats) {
+                Cache->printStats(OutStream());
+                OutStream().flush();
+            }
+            return 0;
+        }
+    }
+
+    // Parsing goes on past a bad item to report the rest, nothing is written then.
+    unsigned Errors = NumErrors();
     std::string TopFuncName = "main";
-    TheParser = std::make_unique<Parser>(src, filename);
+    vector<StringRef> Buffers = { StringRef(Prelude, sizeof(Prelude) - 1), src.getBuffer() };
+    MainParser = std::make_unique<Parser>(Buffers, filename, OptLevel);
+    TheParser = MainParser.get();
     TheParser->SetTopFuncName(TopFuncName);
 
-    MainLoop();
+    if (opts["tiered"] == "1") {
+        InitializeTarget();
+        string CPU, Features;
+        getTargetCPUAndFeatures(opts, CPU, Features);
+        // Only hot code gets compiled, it is worth optimizing whatever -O says.
+        unsigned HotOptLevel = std::max(OptLevel, 2u);
+        auto JIT = PlayJIT::Create(CPU, Features, getCodeGenOptLevel(HotOptLevel), nullptr);
+        if (!JIT)
+            return 1;
+        TieredRuntime Runtime(*JIT, [&](Module &M) { PrepareModule(M, &JIT->getTargetMachine(), HotOptLevel); });
+        TheParser->SetTiered(&Runtime);
+        MainLoop();
+        if (NumErrors() != Errors)
+            return 1;
+        return RunTiered(Runtime, TopFuncName, opts.find("stats") != opts.end());
+    }
 
-    cout << "### Module Bitcode ###" << endl;
-    TheParser->getModule().print(outs(), nullptr);
+    // Items are optimized as they are generated, the linked module isn't again.
+    unique_ptr<IncrementalBuild> Incremental;
+    unique_ptr<StreamBuild> Stream;
+    SkimmedTokens Skimmed;
+    unique_ptr<LazyBuild> Lazy;
+    unsigned NumThreads = 0;
+    bool Pipelined = false;
+    if (opts.find("incremental") != opts.end() && opts["jit"] != "1") {
+        InitializeTarget();
+        string TargetTriple = sys::getDefaultTargetTriple(), CPU, Features;
+        getTargetCPUAndFeatures(opts, CPU, Features);
+        auto TM = getTargetMachine(TargetTriple, CPU, Features, OptLevel);
+        if (!TM)
+            return 1;
+        auto Dir = opts["incremental"].empty() ? Filename + ".inc" : opts["incremental"];
+        Incremental = std::make_unique<IncrementalBuild>(Dir, getCacheKey("", opts), [=](Module &M) { PrepareModule(M, TM, OptLevel); },
+            [=](Module &M, raw_pwrite_stream &OS) { return EmitObject(TM, M, OS); });
+        TheParser->SetItemBuilder(Incremental.get());
+    } else if (opts.find("threads") != opts.end() && opts["jit"] != "1") {
+        NumThreads = (unsigned)atoi(opts["threads"].c_str());
+        if (!NumThreads)
+            NumThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        // One trace stream, the shards would interleave their lines.
+        if (DLogMask())
+            NumThreads = 1;
+    } else if (opts.find("stream") != opts.end() && opts["jit"] != "1") {
+        InitializeTarget();
+        string TargetTriple = sys::getDefaultTargetTriple(), CPU, Features;
+        getTargetCPUAndFeatures(opts, CPU, Features);
+        auto TM = getTargetMachine(TargetTriple, CPU, Features, OptLevel);
+        if (!TM)
+            return 1;
+        Stream = std::make_unique<StreamBuild>([=](Module &M) { PrepareModule(M, TM, OptLevel); },
+            [=](Module &M, raw_pwrite_stream &OS) { return EmitObject(TM, M, OS); });
+        TheParser->SetItemBuilder(Stream.get());
+        TheParser->SetSeparateBodies();
+    } else if (opts.find("pipeline") != opts.end() && opts["jit"] != "1") {
+        Pipelined = true;
+    } else if (opts.find("lazy") != opts.end()) {
+        {
+            TimePhase Phase("skim", "Skim tokens");
+            Skimmed = SkimmedTokens::skim(Buffers);
+            Lazy = std::make_unique<LazyBuild>(Skimmed, TopFuncName);
+        }
+        // Parsed again from the skimmed tokens, so dead bodies can be stepped over.
+        MainParser = std::make_unique<Parser>(Buffers, filename, OptLevel, nullptr, &Skimmed);
+        TheParser = MainParser.get();
+        TheParser->SetTopFuncName(TopFuncName);
+        TheParser->SetItemBuilder(Lazy.get());
+    }
+
+    // The parsers of shards and pipelines are gone by the time the stats are taken.
+    size_t NumTokens, NumNodes;
+    if (NumThreads) {
+        InitializeTarget();
+        if (!RunShards(Buffers, filename, TopFuncName, OptLevel, NumThreads, opts, NumTokens, NumNodes))
+            return 1;
+    } else if (Pipelined) {
+        InitializeTarget();
+        if (!RunPipeline(Buffers, filename, TopFuncName, OptLevel, opts, PrintStats, NumTokens, NumNodes))
+            return 1;
+    } else {
+        MainLoop();
+        NumTokens = TheParser->getNumTokens();
+        NumNodes = TheParser->getASTContext().getNumNodes();
+    }
+    if (NumErrors() != Errors)
+        return 1;
+
+    if (Lazy) {
+        TimePhase Phase("dce", "Dead function elimination");
+        LazyBuild::internalize(TheParser->getModule(), TopFuncName);
+    }
+
+    if (PrintStats) {
+        if (NumThreads || Pipelined)
+            cout << "### AST Stats ###" << endl << "nodes: " << NumNodes << endl;
+        else
+            PrintASTStats(TheParser->getASTContext());
+    }
+    if (Stats) {
+        Stats->SourceBytes = src.getBuffer().size();
+        Stats->Tokens = NumTokens;
+        Stats->ASTNodes = NumNodes;
+        Stats->IRInstructions = TheParser->getModule().getInstructionCount();
+    }
 
-    LLVMInitializeX86TargetInfo();
-    LLVMInitializeX86Target();
-    LLVMInitializeX86TargetMC();
-    LLVMInitializeX86AsmParser();
-    LLVMInitializeX86AsmPrinter();
+    // Every function has been generated, drop the whole AST at once.
+    {
+        TimePhase Phase("release", "Release AST");
+        TheParser->ReleaseAST();
+    }
+
+    if (DLogEnabled(DLT_IR)) {
+        DLogStream() << "### Module Bitcode ###\n";
+        TheParser->getModule().print(DLogStream(), nullptr);
+    }
+
+    InitializeTarget();
 
     auto TargetTriple = sys::getDefaultTargetTriple();
     TheParser->getModule().setTargetTriple(TargetTriple);
 
-    string Error;
-    auto Target = TargetRegistry::lookupTarget(TargetTriple, Error);
+    string CPU, Features;
+    getTargetCPUAndFeatures(opts, CPU, Features);
 
-    if (!Target) {
-        LogError(Error.c_str());
+    SetTargetAttributes(TheParser->getModule(), CPU, Features);
+
+    if (opts["jit"] == "1")
+        return RunJIT(TopFuncName, OptLevel, CPU, Features);
+
+    auto TheTargetMachine = getTargetMachine(TargetTriple, CPU, Features, OptLevel);
+    if (!TheTargetMachine)
         return 1;
+    TheParser->getModule().setDataLayout(TheTargetMachine->createDataLayout());
+
+    if (!Incremental && !NumThreads && !Stream && !Pipelined)
+        OptimizeModule(TheParser->getModule(), TheTargetMachine, OptLevel);
+
+    if (Stream || Incremental) {
+        // The chunks are emitted already, only the last one and the link are left.
+        // Incremental items are emitted or reused as objects, only the link is.
+        if (Stream ? !Stream->finish(Filename) : !Incremental->finish(Filename))
+            return 1;
+        uint64_t Size = 0;
+        sys::fs::file_size(Filename, Size);
+        if (Stats)
+            Stats->ObjectBytes = Size;
+    } else {
+        std::error_code EC;
+        raw_fd_ostream dest(Filename, EC, sys::fs::OF_None);
+
+        legacy::PassManager Pass;
+        auto FileType = llvm::TargetMachine::CGFT_ObjectFile;
+
+        if (TheTargetMachine->addPassesToEmitFile(Pass, dest, nullptr, FileType)) {
+            LogError("TheTargetMachine can't emit a file of this type");
+            return 1;
+        }
+
+        {
+            TimePhase Phase("emit", "Object emission");
+            Pass.run(TheParser->getModule());
+            dest.flush();
+        }
+        if (Stats)
+            Stats->ObjectBytes = dest.tell();
     }
+    DLogStream().flush();
 
-    auto CPU = "generic";
-    auto Features = "";
+    if (Cache)
+        Cache->store(CacheKey, Filename);
+    PrintWrote(Filename);
 
-    TargetOptions opt;
-    auto RM = Optional<Reloc::Model>();
-    auto TheTargetMachine = Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM);
-    TheParser->getModule().setDataLayout(TheTargetMachine->createDataLayout());
+    if (PrintStats) {
+        cout << "peak RSS: " << getPeakRSSKB() << " KB" << endl;
+        if (Cache)
+            Cache->printStats(OutStream());
+        if (Incremental)
+            Incremental->printStats(OutStream());
+        if (NumThreads)
+            OutStream() << "threads: " << NumThreads << "\n";
+        if (Stream)
+            Stream->printStats(OutStream());
+        if (Lazy)
+            Lazy->printStats(OutStream());
+        OutStream().flush();
+    }
+    return 0;
+}
 
-    auto Filename = opts.find("out") != opts.end() ? opts["out"] : "output.o";
-    std::error_code EC;
-    raw_fd_ostream dest(Filename, EC, sys::fs::OF_None);
+int compile(std::string &filename, SourceBuffer &src, std::map<string, string> &opts, CompileStats *Stats)
+{
+    if (!DLogInit(opts["trace"], opts["trace-file"]))
+        return 1;
+    bool TimeTrace = opts.find("time-trace") != opts.end();
+    InitTiming(opts.find("time-report") != opts.end(), TimeTrace);
 
-    legacy::PassManager Pass;
-    auto FileType = llvm::TargetMachine::CGFT_ObjectFile;
+    int Ret = CompileSource(filename, src, opts, Stats);
+    PrintTimeReport(ErrStream());
+    if (TimeTrace) {
+        auto Filename = opts.find("out") != opts.end() ? opts["out"] : "output.o";
+        auto TracePath = opts["time-trace"].empty() ? Filename + ".json" : opts["time-trace"];
+        if (!WriteTimeTrace(TracePath))
+            return 1;
+    }
+    return Ret;
+}
 
-    if (TheTargetMachine->addPassesToEmitFile(Pass, dest, nullptr, FileType)) {
-        LogError("TheTargetMachine can't emit a file of this type");
+/// CollectInputs - Files as they are given, directories as the .play files
+/// in them, by name. Returns false if a directory can't be read.
+static bool CollectInputs(const vector<string> &Inputs, vector<string> &Files) {
+    for (auto &Input : Inputs) {
+        if (!sys::fs::is_directory(Input)) {
+            Files.push_back(Input);
+            continue;
+        }
+        vector<string> Found;
+        error_code EC;
+        for (sys::fs::directory_iterator I(Input, EC), E; I != E && !EC; I.increment(EC)) {
+            if (sys::path::extension(I->path()) == ".play")
+                Found.push_back(I->path());
+        }
+        if (EC) {
+            cerr << "LogError: can't read " << Input << ": " << EC.message() << endl;
+            return false;
+        }
+        std::sort(Found.begin(), Found.end());
+        Files.insert(Files.end(), Found.begin(), Found.end());
+    }
+    return true;
+}
+
+/// BatchJob - One file of a batch and how its compile went.
+struct BatchJob {
+    string Input;
+    string Output;
+    uint64_t Size = 0;
+    int Ret = 1;
+    double Seconds = 0;
+    CompileStats Stats;
+};
+
+int compileBatch(std::vector<std::string> &inputs, std::map<string, string> &opts)
+{
+    if (!DLogInit(opts["trace"], opts["trace-file"]))
+        return 1;
+    // Timers and the trace follow one thread, per file phases go to -stats instead.
+    InitTiming(false, false);
+    InitializeTarget();
+
+    vector<string> Files;
+    if (!CollectInputs(inputs, Files))
         return 1;
+    string OutDir = opts.find("out") != opts.end() ? opts["out"] : "";
+    if (!OutDir.empty()) {
+        if (auto EC = sys::fs::create_directories(OutDir)) {
+            cerr << "LogError: can't create " << OutDir << ": " << EC.message() << endl;
+            return 1;
+        }
+    }
+
+    vector<BatchJob> Jobs(Files.size());
+    for (size_t i = 0; i < Files.size(); i++) {
+        auto &Job = Jobs[i];
+        Job.Input = Files[i];
+        SmallString<128> Output(Job.Input);
+        sys::path::replace_extension(Output, "o");
+        if (!OutDir.empty()) {
+            Output = OutDir;
+            sys::path::append(Output, sys::path::filename(Job.Input));
+            sys::path::replace_extension(Output, "o");
+        }
+        Job.Output = Output.str().str();
+        sys::fs::file_size(Job.Input, Job.Size);
     }
 
-    Pass.run(TheParser->getModule());
-    dest.flush();
+    std::map<string, string> JobOpts = opts;
+    JobOpts.erase("stats");
+    JobOpts.erase("time-report");
+    JobOpts.erase("time-trace");
+    JobOpts.erase("jobs");
+    unsigned NumWorkers = opts.find("jobs") != opts.end() ? (unsigned)atoi(opts["jobs"].c_str()) : 0;
+    // One trace stream, the files would interleave their lines.
+    if (DLogMask())
+        NumWorkers = 1;
 
-    cout << "Wrote " << Filename << endl;
+    auto Start = chrono::steady_clock::now();
+    WorkPool Pool(NumWorkers);
+    // Largest first, so a big file dealt last doesn't leave the others idle.
+    vector<BatchJob *> Order;
+    for (auto &Job : Jobs)
+        Order.push_back(&Job);
+    std::stable_sort(Order.begin(), Order.end(), [](BatchJob *A, BatchJob *B) { return A->Size > B->Size; });
+    for (auto *Job : Order) {
+        // The workers trace like the thread that set the batch up.
+        Pool.async([Job, &JobOpts, Mask = DLogMask(), File = DLogFile()] {
+            DLogMask() = Mask;
+            DLogFile() = File;
+            auto JobStart = chrono::steady_clock::now();
+            auto Src = SourceBuffer::getFile(Job->Input);
+            if (Src) {
+                auto Opts = JobOpts;
+                Opts["out"] = Job->Output;
+                Job->Ret = CompileSource(Job->Input, *Src, Opts, &Job->Stats);
+            }
+            Job->Seconds = chrono::duration<double>(chrono::steady_clock::now() - JobStart).count();
+        });
+    }
+    Pool.wait();
+    double Wall = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+
+    unsigned NumFailed = 0;
+    uint64_t TotalBytes = 0;
+    double TotalSeconds = 0;
+    for (auto &Job : Jobs) {
+        NumFailed += Job.Ret != 0;
+        TotalBytes += Job.Size;
+        TotalSeconds += Job.Seconds;
+    }
+
+    if (opts.find("stats") != opts.end()) {
+        outs() << "### Batch Stats ###\n";
+        for (auto &Job : Jobs) {
+            outs() << Job.Input << ": " << (Job.Ret ? "failed, " : "")
+                   << format("%.1f ms, %.1f KB, %.2f MB/s", Job.Seconds * 1e3, Job.Size / 1024.0,
+                             Job.Seconds > 0 ? Job.Size / Job.Seconds / 1e6 : 0.0);
+            for (auto &P : Job.Stats.PhaseSeconds)
+                outs() << ", " << P.first << " " << format("%.1f", P.second * 1e3) << " ms";
+            outs() << "\n";
+        }
+        outs() << "workers: " << Pool.getNumThreads() << ", tasks stolen: " << Pool.getNumStolen()
+               << ", compile time: " << format("%.3f", TotalSeconds) << " s\n";
+    }
+    outs() << "Compiled " << Jobs.size() - NumFailed << " of " << Jobs.size() << " files"
+           << format(" in %.3f s, %.1f files/s, %.2f MB/s\n", Wall, Wall > 0 ? Jobs.size() / Wall : 0.0,
+                     Wall > 0 ? TotalBytes / Wall / 1e6 : 0.0);
+    outs().flush();
+    return NumFailed ? 1 : 0;
+}
+
+/// ReadItem - Reads lines from stdin until the braces balance and a line ends
+/// in ';' or '}', so a definition reaches the parser whole. Returns false at
+/// the end of input or on an exit line.
+static bool ReadItem(string &Item, bool Prompt) {
+    Item.clear();
+    int Depth = 0;
+    string Line;
+    if (Prompt)
+        errs() << "play> ";
+    while (getline(cin, Line)) {
+        StringRef Code = StringRef(Line).split('#').first.trim();
+        if (StringRef(Item).trim().empty() && (Code == "exit" || Code == "exit;"))
+            return false;
+        Item += Line;
+        Item += '\n';
+        Depth += Code.count('{') - Code.count('}');
+        if (Depth <= 0 && (Code.endswith(";") || Code.endswith("}")))
+            return true;
+        if (Prompt)
+            errs() << (StringRef(Item).trim().empty() ? "play> " : "....> ");
+    }
+    return !StringRef(Item).trim().empty();
+}
+
+/// AddToJIT - Moves the items generated so far into the session as a module
+/// of their own, and starts a new one for the next item.
+static bool AddToJIT(PlayJIT &JIT) {
+    auto M = TheParser->takeModule();
+    TheParser->InitializeModuleAndPassManager();
+
+    // Declarations and class types need no code, the context keeps the types.
+    if (none_of(*M, [](Function &F) { return !F.isDeclaration(); }))
+        return true;
+    if (verifyModule(*M, &errs())) {
+        cerr << "LogError: invalid code, not run" << endl;
+        return false;
+    }
+
+    SetModuleTarget(*M, &JIT.getTargetMachine());
+    return JIT.addModule(orc::ThreadSafeModule(std::move(M), TheParser->getThreadSafeContext()));
+}
+
+static void PrintResult(Type *Ty, uint64_t Bits) {
+    if (Ty->isIntegerTy(1))
+        cout << "=> " << (Bits ? "true" : "false") << endl;
+    else if (Ty->isDoubleTy())
+        cout << "=> " << BitsToDouble(Bits) << endl;
+    else
+        cout << "=> " << (long)Bits << endl;
+}
+
+int repl(std::map<string, string> &opts)
+{
+    if (!DLogInit(opts["trace"], opts["trace-file"]))
+        return 1;
+    InitTiming(opts.find("time-report") != opts.end(), false);
+
+    unsigned OptLevel = opts.find("O") != opts.end() ? (unsigned)atoi(opts["O"].c_str()) : 0;
+    if (OptLevel > 3)
+        OptLevel = 3;
+
+    InitializeTarget();
+    string CPU, Features;
+    getTargetCPUAndFeatures(opts, CPU, Features);
+
+    auto JIT = PlayJIT::Create(CPU, Features, getCodeGenOptLevel(OptLevel), [OptLevel](Module &M, TargetMachine &TM) {
+        OptimizeModule(M, &TM, OptLevel);
+    });
+    if (!JIT)
+        return 1;
+
+    // The AST is never released, later items refer to the classes and
+    // prototypes of earlier ones.
+    MainParser = std::make_unique<Parser>(vector<StringRef>{ StringRef(Prelude, sizeof(Prelude) - 1) }, "repl", OptLevel);
+    TheParser = MainParser.get();
+    TheParser->SetInteractive();
+    auto scope = TheParser->NewScope(nullptr);
+
+    BumpPtrAllocator InputAlloc;
+    StringSaver Input(InputAlloc);
+    bool Prompt = sys::Process::StandardInIsUserInput();
+    string Item;
+    do {
+        while (TheParser->getCurToken() != tok_eof) {
+            HandleTopLevel(scope);
+            Symbol ExprName;
+            auto *Expr = TheParser->takeExpr(ExprName);
+            if (!AddToJIT(*JIT) || !Expr)
+                continue;
+
+            auto Addr = JIT->lookup(ExprName.str());
+            if (!Addr)
+                continue;
+            uint64_t Bits;
+            {
+                TimePhase Phase("run", "JIT run");
+                Bits = ((uint64_t (*)())Addr)();
+            }
+            if (Expr->getResultType())
+                PrintResult(Expr->getResultType(), Bits);
+        }
+        if (!ReadItem(Item, Prompt))
+            break;
+        TheParser->appendInput(Input.save(Item));
+        TheParser->getNextToken();
+    } while (true);
 
+    if (Prompt)
+        errs() << "\n";
+    PrintTimeReport(errs());
     return 0;
 }
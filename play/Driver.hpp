@@ -11,7 +11,35 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
-extern int compile(std::string &filename, std::string &src, std::map<std::string, std::string> &opts);
+#include "SourceBuffer.hpp"
+
+/// CompileStats - What one compile produced and the wall time of each phase,
+/// filled in for the benchmarks.
+struct CompileStats {
+    size_t SourceBytes = 0;
+    size_t Tokens = 0;
+    size_t ASTNodes = 0;
+    size_t IRInstructions = 0;
+    size_t ObjectBytes = 0;
+    std::map<std::string, double> PhaseSeconds;
+};
+
+extern int compile(std::string &filename, SourceBuffer &src, std::map<std::string, std::string> &opts,
+                   CompileStats *Stats = nullptr);
+
+/// compileBatch - Compiles every input, a directory standing for the .play
+/// files in it, each into an object file next to its source or in the
+/// directory given with -o. The files are compiled on a work stealing pool of
+/// --jobs threads, one per core by default, and the aggregate throughput is
+/// printed, with each file's times under -stats. Returns 1 if any failed.
+extern int compileBatch(std::vector<std::string> &inputs, std::map<std::string, std::string> &opts);
+
+/// repl - Reads top level items from stdin and runs each one as it comes,
+/// printing the value of expressions. Every item is generated into a small
+/// module of its own and added to one JIT session, earlier functions and
+/// classes are reached by symbol and never generated again.
+extern int repl(std::map<std::string, std::string> &opts);
 
 #endif /* Dirver_h */
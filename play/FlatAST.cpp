@@ -0,0 +1,301 @@
+//
+//  FlatAST.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "FlatAST.hpp"
+
+using namespace std;
+using namespace llvm;
+
+const unsigned FlatAST::NoNode;
+
+unsigned FlatAST::addNode(FlatKind Kind, unsigned NumChildren, char Op) {
+    FlatNode Node;
+    Node.Kind = Kind;
+    Node.Op = Op;
+    Node.FirstChild = (unsigned)Children.size();
+    Node.NumChildren = NumChildren;
+    Node.TypeIndex = 0;
+    Node.Int = 0;
+    Nodes.push_back(Node);
+    Children.resize(Children.size() + NumChildren, NoNode);
+    return (unsigned)Nodes.size() - 1;
+}
+
+unsigned VarExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Var, 1);
+    F.setName(N, Name);
+    F.setType(N, Type);
+    F.setChild(N, 0, Init.get());
+    return N;
+}
+
+unsigned CompoundExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Compound, (unsigned)Exprs.size());
+    for (unsigned i = 0; i < Exprs.size(); i++)
+        F.setChild(N, i, Exprs[i].get());
+    return N;
+}
+
+unsigned IntegerLiteralAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_IntegerLiteral, 0);
+    F.getNode(N).Int = Val;
+    return N;
+}
+
+unsigned FloatLiteralAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_FloatLiteral, 0);
+    F.getNode(N).Float = Val;
+    return N;
+}
+
+unsigned VariableExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Variable, 0);
+    F.setName(N, Name);
+    return N;
+}
+
+unsigned RightValueAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_RightValue, 1);
+    F.setChild(N, 0, Expr.get());
+    return N;
+}
+
+unsigned BinaryExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Binary, 2, Op);
+    F.setChild(N, 0, LHS.get());
+    F.setChild(N, 1, RHS.get());
+    return N;
+}
+
+unsigned CallExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Call, (unsigned)Args.size());
+    F.setName(N, Callee);
+    for (unsigned i = 0; i < Args.size(); i++)
+        F.setChild(N, i, Args[i].get());
+    return N;
+}
+
+unsigned MethodCallAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_MethodCall, 1 + (unsigned)Args.size());
+    F.setName(N, Callee);
+    F.setChild(N, 0, Var.get());
+    for (unsigned i = 0; i < Args.size(); i++)
+        F.setChild(N, 1 + i, Args[i].get());
+    return N;
+}
+
+unsigned MemberAccessAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_MemberAccess, 2);
+    F.setName(N, Member);
+    F.setChild(N, 0, Var.get());
+    F.setChild(N, 1, RHS.get());
+    return N;
+}
+
+unsigned IndexerAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Indexer, 3);
+    F.setChild(N, 0, Var.get());
+    F.setChild(N, 1, Index.get());
+    F.setChild(N, 2, RHS.get());
+    return N;
+}
+
+unsigned IfExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_If, 3);
+    F.setChild(N, 0, Cond.get());
+    F.setChild(N, 1, Then.get());
+    F.setChild(N, 2, Else.get());
+    return N;
+}
+
+unsigned ForExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_For, 4);
+    F.setChild(N, 0, Var.get());
+    F.setChild(N, 1, End.get());
+    F.setChild(N, 2, Step.get());
+    F.setChild(N, 3, Body.get());
+    return N;
+}
+
+unsigned UnaryExprAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Unary, 1, Opcode);
+    F.setChild(N, 0, Operand.get());
+    return N;
+}
+
+unsigned NewAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_New, 1);
+    F.setType(N, Type);
+    F.setChild(N, 0, Size.get());
+    return N;
+}
+
+unsigned DeleteAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Delete, 1);
+    F.setChild(N, 0, Var.get());
+    return N;
+}
+
+unsigned ReturnAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_Return, 1);
+    F.setChild(N, 0, Var.get());
+    return N;
+}
+
+unsigned ExprResultAST::flatten(FlatAST &F) const {
+    unsigned N = F.addNode(FK_ExprResult, 1);
+    F.setChild(N, 0, Expr.get());
+    return N;
+}
+
+namespace {
+
+/// JSONDumper - Appends to one string as it goes, rather than formatting
+/// each subtree into a string of its own.
+class JSONDumper : public FlatVisitor<JSONDumper> {
+    string &Out;
+
+    void field(const FlatNode &Node, unsigned I) {
+        if (hasChild(Node, I))
+            visitChild(Node, I);
+        else
+            Out += "null";
+    }
+    void list(const FlatNode &Node, unsigned From) {
+        Out += "[";
+        for (unsigned I = From; I < Node.NumChildren; I++) {
+            if (I != From)
+                Out += ",";
+            field(Node, I);
+        }
+        Out += "]";
+    }
+
+public:
+    JSONDumper(const FlatAST &ast, string &out) : FlatVisitor(ast), Out(out) {}
+
+    void visitVar(unsigned N, const FlatNode &Node) {
+        Out += FormatString("{`type`: `Var`, `Name`: `%s`, `Type`: %d}", AST.getName(Node).c_str(),
+                            (int)AST.getType(Node).TypeID);
+    }
+    void visitCompound(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `Compound`, `Exprs`: ";
+        list(Node, 0);
+        Out += "}";
+    }
+    void visitIntegerLiteral(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `IntegerLiteral`, `Val`: `" + to_string(Node.Int) + "`}";
+    }
+    void visitFloatLiteral(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `FloatLiteral`, `Val`: `" + to_string(Node.Float) + "`}";
+    }
+    void visitVariable(unsigned N, const FlatNode &Node) {
+        Out += FormatString("{`type`: `Variable`, `Name`: `%s`}", AST.getName(Node).c_str());
+    }
+    void visitRightValue(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `RightValue`, `Expr`: ";
+        field(Node, 0);
+        Out += "}";
+    }
+    void visitBinary(unsigned N, const FlatNode &Node) {
+        Out += FormatString("{`type`: `Binary`, `Operator`: `%c`, `LHS`: ", Node.Op);
+        field(Node, 0);
+        Out += ", `RHS`: ";
+        field(Node, 1);
+        Out += "}";
+    }
+    void visitCall(unsigned N, const FlatNode &Node) {
+        Out += FormatString("{`type`: `Call`, `Callee`: `%s`, `Args`: ", AST.getName(Node).c_str());
+        list(Node, 0);
+        Out += "}";
+    }
+    void visitMethodCall(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `MethodCall`, `Var`: ";
+        field(Node, 0);
+        Out += FormatString(", `Callee`: `%s`, `Args`: ", AST.getName(Node).c_str());
+        list(Node, 1);
+        Out += "}";
+    }
+    void visitMemberAccess(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `MemberAccess`, `Var`: ";
+        field(Node, 0);
+        Out += FormatString(", `Member`: `%s`, `RHS`: ", AST.getName(Node).c_str());
+        field(Node, 1);
+        Out += "}";
+    }
+    void visitIndexer(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `IndexSubscribe`, `Var`: ";
+        field(Node, 0);
+        Out += ", `Index`: ";
+        field(Node, 1);
+        Out += ", `RHS`: ";
+        field(Node, 2);
+        Out += "}";
+    }
+    void visitIf(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `If`, `Cond`: ";
+        field(Node, 0);
+        Out += ", `Then`: ";
+        field(Node, 1);
+        Out += ", `Else`: ";
+        field(Node, 2);
+        Out += "}";
+    }
+    void visitFor(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `For`, `Var`: ";
+        field(Node, 0);
+        Out += ", `End`: ";
+        field(Node, 1);
+        Out += ", `Step`: ";
+        field(Node, 2);
+        Out += ", `Body`: ";
+        field(Node, 3);
+        Out += "}";
+    }
+    void visitUnary(unsigned N, const FlatNode &Node) {
+        Out += FormatString("{`type`: `Unary`, `Operator`: `%c`, `Operand`: ", Node.Op);
+        field(Node, 0);
+        Out += "}";
+    }
+    void visitNew(unsigned N, const FlatNode &Node) {
+        VarType Type = AST.getType(Node);
+        Out += "{`type`: `New`, `Type`: " + Type.dumpJSON() + ", `Size`: ";
+        field(Node, 0);
+        Out += "}";
+    }
+    void visitDelete(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `Delete`, `Var`: ";
+        field(Node, 0);
+        Out += "}";
+    }
+    void visitReturn(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `Return`, `Var`: ";
+        field(Node, 0);
+        Out += "}";
+    }
+    void visitExprResult(unsigned N, const FlatNode &Node) {
+        Out += "{`type`: `ExprResult`, `Expr`: ";
+        field(Node, 0);
+        Out += "}";
+    }
+};
+
+} // end anonymous namespace
+
+string FlatAST::dumpJSON(unsigned N) const {
+    if (N == NoNode)
+        return "null";
+    string Out;
+    JSONDumper(*this, Out).visit(N);
+    return Out;
+}
+
+string ExprAST::dumpJSON() const {
+    FlatAST F;
+    return F.dumpJSON(F.add(this));
+}
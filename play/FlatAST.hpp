@@ -0,0 +1,187 @@
+//
+//  FlatAST.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef FlatAST_hpp
+#define FlatAST_hpp
+
+#include <string>
+#include <vector>
+
+#include "Parser.hpp"
+
+/// FlatKind - One tag per ExprAST subclass.
+enum FlatKind : unsigned char {
+    FK_Var,
+    FK_Compound,
+    FK_IntegerLiteral,
+    FK_FloatLiteral,
+    FK_Variable,
+    FK_RightValue,
+    FK_Binary,
+    FK_Call,
+    FK_MethodCall,
+    FK_MemberAccess,
+    FK_Indexer,
+    FK_If,
+    FK_For,
+    FK_Unary,
+    FK_New,
+    FK_Delete,
+    FK_Return,
+    FK_ExprResult,
+};
+
+/// FlatNode - An expression without pointers: its kind, its operator, a run
+/// of child indices in the FlatAST and the one value its kind carries.
+///
+/// Children by kind, an absent optional one is FlatAST::NoNode:
+///   Var: Init?               Compound: Exprs...        RightValue: Expr
+///   Binary: LHS, RHS         Call: Args...             MethodCall: Var, Args...
+///   MemberAccess: Var, RHS?  Indexer: Var, Index, RHS? If: Cond, Then, Else?
+///   For: Var, End, Step?, Body                         Unary: Operand
+///   New: Size                Delete: Var               Return: Var?
+///   ExprResult: Expr
+struct FlatNode {
+    FlatKind Kind;
+    /// Op - Binary and Unary operator.
+    char Op;
+    unsigned FirstChild;
+    unsigned NumChildren;
+    /// TypeIndex - Var and New, into FlatAST's types.
+    unsigned TypeIndex;
+    union {
+        long Int;
+        double Float;
+        /// Name - Var, Variable, Call, MethodCall and MemberAccess, see FlatAST::getName.
+        const void *Name;
+    };
+};
+
+/// FlatAST - Expression trees laid out in two arrays. Nodes are appended in
+/// pre-order, so a walk moves forward through memory, and the children of a
+/// node are contiguous in the child array. Passes over it are FlatVisitors,
+/// dispatched on the kind tag instead of through a virtual call per node.
+class FlatAST {
+    std::vector<FlatNode> Nodes;
+    std::vector<unsigned> Children;
+    std::vector<VarType> Types;
+
+public:
+    static const unsigned NoNode = ~0u;
+
+    /// add - Flattens the tree under E, returns the index of its root.
+    unsigned add(const ExprAST *E) { return E ? E->flatten(*this) : NoNode; }
+
+    /// addNode - Appends a node with room for NumChildren, filled in with
+    /// setChild. Set its value before adding children, they may move it.
+    unsigned addNode(FlatKind Kind, unsigned NumChildren, char Op = 0);
+    void setChild(unsigned N, unsigned I, const ExprAST *E) {
+        unsigned C = add(E);
+        Children[Nodes[N].FirstChild + I] = C;
+    }
+    void setName(unsigned N, Symbol Name) { Nodes[N].Name = Name.getOpaqueValue(); }
+    void setType(unsigned N, const VarType &Type) {
+        Nodes[N].TypeIndex = (unsigned)Types.size();
+        Types.push_back(Type);
+    }
+    FlatNode &getNode(unsigned N) { return Nodes[N]; }
+
+    const FlatNode &getNode(unsigned N) const { return Nodes[N]; }
+    unsigned getChild(const FlatNode &Node, unsigned I) const { return Children[Node.FirstChild + I]; }
+    Symbol getName(const FlatNode &Node) const {
+        return Symbol(static_cast<const StringMapEntry<char> *>(Node.Name));
+    }
+    const VarType &getType(const FlatNode &Node) const { return Types[Node.TypeIndex]; }
+
+    size_t size() const { return Nodes.size(); }
+    size_t getMemoryBytes() const {
+        return Nodes.capacity() * sizeof(FlatNode) + Children.capacity() * sizeof(unsigned) +
+               Types.capacity() * sizeof(VarType);
+    }
+    void clear() {
+        Nodes.clear();
+        Children.clear();
+        Types.clear();
+    }
+
+    std::string dumpJSON(unsigned N) const;
+};
+
+/// FlatVisitor - Walks a FlatAST with statically dispatched handlers, like
+/// LLVM's InstVisitor. SubClass defines visitBinary, visitCall and so on for
+/// the kinds it handles, the others go to visitNode, which by default visits
+/// the children and returns RetTy(). Handlers recurse with visitChild.
+template <typename SubClass, typename RetTy = void>
+class FlatVisitor {
+protected:
+    const FlatAST &AST;
+
+public:
+    explicit FlatVisitor(const FlatAST &ast) : AST(ast) {}
+
+    RetTy visit(unsigned N) {
+        auto &Node = AST.getNode(N);
+        auto *Self = static_cast<SubClass *>(this);
+        switch (Node.Kind) {
+            case FK_Var: return Self->visitVar(N, Node);
+            case FK_Compound: return Self->visitCompound(N, Node);
+            case FK_IntegerLiteral: return Self->visitIntegerLiteral(N, Node);
+            case FK_FloatLiteral: return Self->visitFloatLiteral(N, Node);
+            case FK_Variable: return Self->visitVariable(N, Node);
+            case FK_RightValue: return Self->visitRightValue(N, Node);
+            case FK_Binary: return Self->visitBinary(N, Node);
+            case FK_Call: return Self->visitCall(N, Node);
+            case FK_MethodCall: return Self->visitMethodCall(N, Node);
+            case FK_MemberAccess: return Self->visitMemberAccess(N, Node);
+            case FK_Indexer: return Self->visitIndexer(N, Node);
+            case FK_If: return Self->visitIf(N, Node);
+            case FK_For: return Self->visitFor(N, Node);
+            case FK_Unary: return Self->visitUnary(N, Node);
+            case FK_New: return Self->visitNew(N, Node);
+            case FK_Delete: return Self->visitDelete(N, Node);
+            case FK_Return: return Self->visitReturn(N, Node);
+            case FK_ExprResult: return Self->visitExprResult(N, Node);
+        }
+        llvm_unreachable("unknown FlatKind");
+    }
+
+    bool hasChild(const FlatNode &Node, unsigned I) const { return AST.getChild(Node, I) != FlatAST::NoNode; }
+    RetTy visitChild(const FlatNode &Node, unsigned I) { return visit(AST.getChild(Node, I)); }
+
+    RetTy visitNode(unsigned N, const FlatNode &Node) {
+        for (unsigned I = 0; I < Node.NumChildren; I++) {
+            if (hasChild(Node, I))
+                visitChild(Node, I);
+        }
+        return RetTy();
+    }
+
+#define FLAT_VISIT(KIND) \
+    RetTy visit##KIND(unsigned N, const FlatNode &Node) { return static_cast<SubClass *>(this)->visitNode(N, Node); }
+    FLAT_VISIT(Var)
+    FLAT_VISIT(Compound)
+    FLAT_VISIT(IntegerLiteral)
+    FLAT_VISIT(FloatLiteral)
+    FLAT_VISIT(Variable)
+    FLAT_VISIT(RightValue)
+    FLAT_VISIT(Binary)
+    FLAT_VISIT(Call)
+    FLAT_VISIT(MethodCall)
+    FLAT_VISIT(MemberAccess)
+    FLAT_VISIT(Indexer)
+    FLAT_VISIT(If)
+    FLAT_VISIT(For)
+    FLAT_VISIT(Unary)
+    FLAT_VISIT(New)
+    FLAT_VISIT(Delete)
+    FLAT_VISIT(Return)
+    FLAT_VISIT(ExprResult)
+#undef FLAT_VISIT
+};
+
+#endif /* FlatAST_hpp */
@@ -11,6 +11,18 @@
 
 #include <string>
 #include <iostream>
+#include <memory>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+// Build with -DPLAY_TRACE=0 to compile every trace point out.
+#ifndef PLAY_TRACE
+#define PLAY_TRACE 1
+#endif
 
 enum DLogTag {
     DLT_SRC,
@@ -20,8 +32,111 @@ enum DLogTag {
     DLT_OTH,
 };
 
-inline void DLog(DLogTag Tag, std::string Msg) {
-    std::cout << Msg << std::endl;
+/// OutputCapture - What one compile printed, kept for the compile server to
+/// send back to its client.
+struct OutputCapture {
+    std::string Out;
+    std::string Err;
+    llvm::raw_string_ostream OutOS{Out};
+    llvm::raw_string_ostream ErrOS{Err};
+
+    OutputCapture() {
+        OutOS.SetUnbuffered();
+        ErrOS.SetUnbuffered();
+    }
+};
+
+/// CapturedOutput - Set while this thread's output is captured.
+inline OutputCapture *&CapturedOutput() {
+    static thread_local OutputCapture *Capture = nullptr;
+    return Capture;
+}
+
+/// OutStream, ErrStream - outs() and errs(), or the capture of this thread.
+/// The compile path prints through these.
+inline llvm::raw_ostream &OutStream() {
+    if (auto *Capture = CapturedOutput())
+        return Capture->OutOS;
+    return llvm::outs();
+}
+
+inline llvm::raw_ostream &ErrStream() {
+    if (auto *Capture = CapturedOutput())
+        return Capture->ErrOS;
+    return llvm::errs();
+}
+
+/// DLogMask - Bit per enabled DLogTag, nothing is traced by default. Each
+/// thread has its own, so compile server requests trace independently.
+inline unsigned &DLogMask() {
+    static thread_local unsigned Mask = 0;
+    return Mask;
+}
+
+inline bool DLogEnabled(DLogTag Tag) {
+    return PLAY_TRACE && (DLogMask() & (1u << Tag));
+}
+
+/// DLogFile - Trace file opened by DLogInit on this thread, traces go to
+/// stdout without one. Threads working for the same compile share it.
+inline std::shared_ptr<llvm::raw_fd_ostream> &DLogFile() {
+    static thread_local std::shared_ptr<llvm::raw_fd_ostream> File;
+    return File;
+}
+
+inline llvm::raw_ostream &DLogStream() {
+    return DLogFile() ? *DLogFile() : OutStream();
+}
+
+/// DLog - The message is only evaluated when its category is on, and lines are
+/// buffered rather than flushed one by one.
+#define DLog(Tag, Msg) \
+    do { \
+        if (DLogEnabled(Tag)) \
+            DLogStream() << (Msg) << '\n'; \
+    } while (0)
+
+/// DLogInit - Enables a comma separated list of src, tok, ast, ir, oth or all
+/// on this thread, and sends traces to Path, or to stdout when it is empty.
+/// Returns false on bad input.
+inline bool DLogInit(llvm::StringRef Categories, llvm::StringRef Path) {
+    unsigned Mask = 0;
+    llvm::SmallVector<llvm::StringRef, 5> Names;
+    Categories.split(Names, ',', -1, false);
+    for (auto Name : Names) {
+        unsigned Bits = llvm::StringSwitch<unsigned>(Name)
+            .Case("src", 1u << DLT_SRC)
+            .Case("tok", 1u << DLT_TOK)
+            .Case("ast", 1u << DLT_AST)
+            .Case("ir", 1u << DLT_IR)
+            .Case("oth", 1u << DLT_OTH)
+            .Case("all", ~0u)
+            .Default(0);
+        if (!Bits) {
+            std::cerr << "LogError: unknown trace category " << Name.str() << std::endl;
+            return false;
+        }
+        Mask |= Bits;
+    }
+    DLogMask() = Mask;
+
+    // Opened again, the file would lose what earlier compiles traced.
+    static thread_local std::string OpenPath;
+    if (Path == OpenPath)
+        return true;
+    DLogFile().reset();
+    OpenPath.clear();
+    if (Path.empty())
+        return true;
+    std::error_code EC;
+    auto File = std::make_unique<llvm::raw_fd_ostream>(Path, EC, llvm::sys::fs::OF_None);
+    if (EC) {
+        std::cerr << "LogError: can't open trace file " << Path.str() << ": " << EC.message() << std::endl;
+        return false;
+    }
+    DLogFile() = std::move(File);
+    OpenPath = Path.str();
+    return true;
 }
 
 #endif /* GlobalVars_h */
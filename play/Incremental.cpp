@@ -0,0 +1,206 @@
+//
+//  Incremental.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Incremental.hpp"
+#include "GlobalVars.hpp"
+#include "BuildSupport.hpp"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+
+using namespace std;
+using namespace llvm;
+
+IncrementalBuild::IncrementalBuild(StringRef dir, StringRef salt, PrepareFunction prepare, EmitFunction emit)
+    : Dir(dir), Salt(salt), Prepare(std::move(prepare)), Emit(std::move(emit)) {
+    if (auto EC = sys::fs::create_directories(Dir)) {
+        cerr << "LogError: can't create " << Dir << ": " << EC.message() << endl;
+        Failed = true;
+    }
+}
+
+string IncrementalBuild::getTypeName(const VarType &T) const {
+    switch (T.TypeID) {
+        case VarTypeVoid: return "void";
+        case VarTypeBool: return "bool";
+        case VarTypeInt: return "int";
+        case VarTypeFloat: return "float";
+        case VarTypeString: return "string";
+        case VarTypeStar: return getTypeName(*T.PointedType) + "*";
+        default: return T.ClassName;
+    }
+}
+
+string IncrementalBuild::getSignature(const PrototypeAST &P, bool ExpandClasses) const {
+    auto Expand = [&](const VarType &T) {
+        auto Name = getTypeName(T);
+        // A caller passing or returning an object depends on its layout too.
+        if (ExpandClasses && T.TypeID == VarTypeObject) {
+            auto L = Layouts.find(intern(T.ClassName));
+            if (L != Layouts.end())
+                Name += L->second;
+        }
+        return Name;
+    };
+    string Sig = Expand(P.getRetType()) + " " + P.getName().str() + "(";
+    for (size_t i = 0; i < P.getNumArgs(); i++)
+        Sig += Expand(P.getArgType(i)) + ",";
+    Sig += ")";
+    if (P.isBinaryOp())
+        Sig += " " + to_string(P.getBinaryPrecedence());
+    return Sig;
+}
+
+void IncrementalBuild::beginItem() {
+    InItem = true;
+    ItemTokens.clear();
+    ItemSymbols.clear();
+}
+
+string IncrementalBuild::endItem() {
+    InItem = false;
+    SHA1 Hash;
+    Hash.update(Salt);
+    Hash.update(ItemTokens);
+    // Operators change how every later item parses.
+    Hash.update(Operators);
+
+    SmallDenseSet<Symbol, 16> Seen;
+    for (auto S : ItemSymbols) {
+        if (!Seen.insert(S).second)
+            continue;
+        auto F = Signatures.find(S);
+        if (F != Signatures.end())
+            Hash.update(F->second);
+        auto C = Layouts.find(S);
+        if (C != Layouts.end())
+            Hash.update(C->second);
+    }
+    return toHex(Hash.result(), true);
+}
+
+string IncrementalBuild::getPath(StringRef Key) const {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Key + ".o");
+    return Path.str().str();
+}
+
+bool IncrementalBuild::reuse(StringRef Key) {
+    auto Path = getPath(Key);
+    if (!sys::fs::exists(Path))
+        return false;
+    Live.insert(Key);
+    Objects.push_back(Path);
+    return true;
+}
+
+void IncrementalBuild::save(StringRef Key) {
+    auto M = TheParser->takeModule();
+    TheParser->InitializeModuleAndPassManager();
+    if (Failed)
+        return;
+    if (verifyModule(*M, &ErrStream())) {
+        cerr << "LogError: invalid code in item " << Objects.size() << endl;
+        Failed = true;
+        return;
+    }
+    Prepare(*M);
+
+    auto Path = getPath(Key);
+    TimePhase Phase("emit", "Object emission");
+    if (!writeFileAtomically(Path, [&](raw_pwrite_stream &OS) { return Emit(*M, OS); })) {
+        cerr << "LogError: can't write " << Path << endl;
+        Failed = true;
+        return;
+    }
+    Live.insert(Key);
+    Objects.push_back(Path);
+}
+
+void IncrementalBuild::addExtern(const PrototypeAST &P) {
+    Signatures[P.getSymbol()] = getSignature(P, true);
+}
+
+void IncrementalBuild::addFunction(FunctionAST *F) {
+    auto Key = endItem();
+    auto &P = F->getProto();
+    Signatures[P.getSymbol()] = getSignature(P, true);
+    if (P.isUnaryOp() || P.isBinaryOp())
+        Operators += getSignature(P, false) + ";";
+
+    if (reuse(Key)) {
+        DLog(DLT_OTH, "incremental: reuse " + P.getName().str());
+        F->declare();
+        NumReused++;
+        return;
+    }
+    DLog(DLT_OTH, "incremental: compile " + P.getName().str());
+    F->codegen();
+    save(Key);
+    NumCompiled++;
+}
+
+void IncrementalBuild::addClass(ClassDeclAST *C) {
+    auto Key = endItem();
+    string Layout = "{";
+    for (size_t i = 0; i < C->getMemberSize(); i++)
+        Layout += getTypeName(C->getMember(i)->VType) + " " + C->getMember(i)->Name.str().str() + ";";
+    for (size_t i = 0; i < C->getNumMethods(); i++)
+        Layout += getSignature(C->getMethod(i)->getProto(), false) + ";";
+    Layouts[C->getName()] = Layout + "}";
+
+    if (reuse(Key)) {
+        DLog(DLT_OTH, string("incremental: reuse class ") + C->getName().c_str());
+        C->declare();
+        NumReused++;
+        return;
+    }
+    DLog(DLT_OTH, string("incremental: compile class ") + C->getName().c_str());
+    C->codegen();
+    save(Key);
+    NumCompiled++;
+}
+
+bool IncrementalBuild::finish(StringRef Output) {
+    if (Failed)
+        return false;
+
+    TimePhase Phase("link", "Link items");
+    bool Linked;
+    if (Objects.empty()) {
+        // Declarations alone, there is no item to link. The output is an object all the same.
+        auto &M = TheParser->getModule();
+        Prepare(M);
+        error_code EC;
+        raw_fd_ostream OS(Output, EC, sys::fs::OF_None);
+        if (EC) {
+            cerr << "LogError: can't write " << Output.str() << ": " << EC.message() << endl;
+            return false;
+        }
+        Linked = Emit(M, OS);
+    } else {
+        Linked = linkObjects(Objects, Dir, Output);
+    }
+
+    // Items edited away, or compiled with other options, and the bitcode of older builds.
+    error_code EC;
+    for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC; I.increment(EC)) {
+        auto Name = sys::path::filename(I->path());
+        if ((Name.endswith(".o") || Name.endswith(".bc")) && !Live.count(sys::path::stem(Name)))
+            sys::fs::remove(I->path());
+    }
+    return Linked;
+}
+
+void IncrementalBuild::printStats(raw_ostream &OS) const {
+    OS << "### Incremental Stats ###\n";
+    OS << "items reused: " << NumReused << ", compiled: " << NumCompiled << "\n";
+}
@@ -0,0 +1,108 @@
+//
+//  Incremental.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Incremental_hpp
+#define Incremental_hpp
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "BuildSupport.hpp"
+#include "Parser.hpp"
+
+/// IncrementalBuild - Compiles each top level function, class and expression
+/// into a module of its own and keeps it in Dir as an object file, named by a
+/// fingerprint of the item. The fingerprint covers the item's tokens, the
+/// signatures of the functions and the layouts of the classes it names,
+/// every operator defined before it, and Salt for the target and options.
+/// An item whose fingerprint is found is only declared, its object file is
+/// linked in as it is. finish joins the objects with a relocatable link, so
+/// an unchanged item costs neither code generation nor emission. Editing a
+/// body recompiles that item alone, editing a signature also recompiles the
+/// items calling it.
+class IncrementalBuild : public ItemBuilder {
+    std::string Dir;
+    std::string Salt;
+    PrepareFunction Prepare;
+    EmitFunction Emit;
+
+    bool InItem = false;
+    llvm::SmallString<256> ItemTokens;
+    llvm::SmallVector<Symbol, 32> ItemSymbols;
+
+    llvm::DenseMap<Symbol, std::string> Signatures;
+    llvm::DenseMap<Symbol, std::string> Layouts;
+    std::string Operators;
+
+    /// Item objects in source order, for finish.
+    std::vector<std::string> Objects;
+    llvm::StringSet<> Live;
+    unsigned NumReused = 0;
+    unsigned NumCompiled = 0;
+    bool Failed = false;
+
+    std::string getTypeName(const VarType &T) const;
+    std::string getSignature(const PrototypeAST &P, bool ExpandClasses) const;
+    std::string endItem();
+    std::string getPath(llvm::StringRef Key) const;
+    /// reuse - Takes the object of Key if there is one. Returns false otherwise.
+    bool reuse(llvm::StringRef Key);
+    void save(llvm::StringRef Key);
+
+public:
+    /// Prepare sets up the module of a compiled item for the target and
+    /// optimizes it, Emit writes its object file.
+    IncrementalBuild(llvm::StringRef Dir, llvm::StringRef Salt, PrepareFunction Prepare, EmitFunction Emit);
+
+    /// beginItem - Starts collecting the tokens of the next top level item.
+    void beginItem() override;
+    /// addToken - Called for every token the parser consumes.
+    void addToken(const TokenInfo &Tok) override {
+        if (!InItem)
+            return;
+        ItemTokens.push_back((char)Tok.Kind);
+        switch (Tok.Kind) {
+            case tok_identifier:
+                ItemTokens += Tok.IdentifierStr;
+                ItemTokens.push_back(0);
+                ItemSymbols.push_back(Tok.IdentifierSym);
+                break;
+            case tok_integer_literal:
+                ItemTokens.append((const char *)&Tok.IntegerVal, (const char *)(&Tok.IntegerVal + 1));
+                break;
+            case tok_float_literal:
+                ItemTokens.append((const char *)&Tok.FloatVal, (const char *)(&Tok.FloatVal + 1));
+                break;
+            default:
+                break;
+        }
+    }
+
+    /// addExtern - Records the signature, externs are always generated.
+    void addExtern(const PrototypeAST &P) override;
+    /// addFunction, addClass - End the item, then load or generate it.
+    void addFunction(FunctionAST *F) override;
+    void addClass(ClassDeclAST *C) override;
+
+    /// finish - Links the object of every item into Output, then deletes the
+    /// objects of items no longer in the source. Returns false if an item or
+    /// the link failed.
+    bool finish(llvm::StringRef Output);
+
+    void printStats(llvm::raw_ostream &OS) const;
+};
+
+#endif /* Incremental_hpp */
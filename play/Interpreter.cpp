@@ -0,0 +1,193 @@
+//
+//  Interpreter.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Interpreter.hpp"
+#include "Tiered.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
+
+using namespace std;
+using namespace llvm;
+
+// Tier 0 walks the same nodes codegen does and follows the IR they generate:
+// the scalar types, locals, if, for, return and calls. Classes, pointers,
+// new and delete are left to native code.
+
+InterpValue InterpValue::convertTo(const VarType &T) const {
+    switch (T.TypeID) {
+        case VarTypeBool:
+            return getBool(Kind == Float ? F != 0 : (I & 1));
+        case VarTypeInt:
+            return getInt(Kind == Float ? (long)F : I);
+        case VarTypeFloat:
+            return getFloat(Kind == Float ? F : (double)I);
+        default:
+            return InterpValue();
+    }
+}
+
+uint64_t InterpValue::getBits() const {
+    return Kind == Float ? DoubleToBits(F) : (uint64_t)I;
+}
+
+InterpValue InterpValue::fromBits(const VarType &T, uint64_t Bits) {
+    switch (T.TypeID) {
+        case VarTypeBool: return getBool(Bits & 1);
+        case VarTypeInt: return getInt((long)Bits);
+        case VarTypeFloat: return getFloat(BitsToDouble(Bits));
+        default: return InterpValue();
+    }
+}
+
+InterpValue *InterpFrame::lookup(const Scope *S, Symbol Name) {
+    for (; S; S = S->Parent) {
+        auto I = Vars.find({S, Name});
+        if (I != Vars.end())
+            return &I->second;
+    }
+    return nullptr;
+}
+
+void InterpFrame::countBackEdge() {
+    Runtime.countBackEdge(Fn);
+}
+
+InterpValue IntegerLiteralAST::interpret(InterpFrame &Frame) {
+    return InterpValue::getInt(Val);
+}
+
+InterpValue FloatLiteralAST::interpret(InterpFrame &Frame) {
+    return InterpValue::getFloat(Val);
+}
+
+InterpValue VariableExprAST::interpret(InterpFrame &Frame) {
+    if (auto *V = Frame.lookup(scope, Name))
+        return *V;
+    LogError("Unkown variable name");
+    return InterpValue();
+}
+
+void VariableExprAST::interpretAssign(InterpFrame &Frame, InterpValue V) {
+    if (auto *Slot = Frame.lookup(scope, Name))
+        *Slot = V;
+    else
+        LogError("Unkown variable name");
+}
+
+InterpValue RightValueAST::interpret(InterpFrame &Frame) {
+    // Variables evaluate to their value already, there is no address to load from.
+    return Expr->interpret(Frame);
+}
+
+InterpValue BinaryExprAST::interpret(InterpFrame &Frame) {
+    if (Op == tok_equal) { // assign
+        auto LHSRV = static_cast<RightValueAST *>(LHS.get());
+        auto Val = RHS->interpret(Frame);
+        LHSRV->getExpr()->interpretAssign(Frame, Val);
+        return Val;
+    }
+
+    auto L = LHS->interpret(Frame);
+    auto R = RHS->interpret(Frame);
+    bool IsFloat = L.Kind == InterpValue::Float;
+    switch (Op) {
+        case tok_add:
+            return IsFloat ? InterpValue::getFloat(L.F + R.F) : InterpValue::getInt(L.I + R.I);
+        case tok_sub:
+            return IsFloat ? InterpValue::getFloat(L.F - R.F) : InterpValue::getInt(L.I - R.I);
+        case tok_mul:
+            return IsFloat ? InterpValue::getFloat(L.F * R.F) : InterpValue::getInt(L.I * R.I);
+        case tok_div:
+            if (IsFloat)
+                return InterpValue::getFloat(L.F / R.F);
+            if (!R.I) {
+                LogError("division by zero");
+                return InterpValue::getInt(0);
+            }
+            return InterpValue::getInt(L.I / R.I);
+        case tok_less:
+            // fcmp ult, unordered operands compare true
+            return InterpValue::getBool(IsFloat ? !(L.F >= R.F) : L.I < R.I);
+        case tok_greater:
+            return InterpValue::getBool(IsFloat ? !(L.F <= R.F) : L.I > R.I);
+        default:
+        {
+            InterpValue Ops[] = { L, R };
+            return Frame.Runtime.call(*Frame.Runtime.getOperator(true, Op), Ops);
+        }
+    }
+}
+
+InterpValue UnaryExprAST::interpret(InterpFrame &Frame) {
+    auto V = Operand->interpret(Frame);
+    switch (Opcode) {
+        case tok_sub:
+            return V.Kind == InterpValue::Float ? InterpValue::getFloat(-V.F) : InterpValue::getInt(-V.I);
+        case tok_add:
+            return V;
+        default:
+            return Frame.Runtime.call(*Frame.Runtime.getOperator(false, Opcode), V);
+    }
+}
+
+InterpValue CompoundExprAST::interpret(InterpFrame &Frame) {
+    for (auto &E : Exprs) {
+        E->interpret(Frame);
+        if (Frame.Returned)
+            break;
+    }
+    return InterpValue();
+}
+
+InterpValue CallExprAST::interpret(InterpFrame &Frame) {
+    SmallVector<InterpValue, 8> ArgsV;
+    for (auto &A : Args)
+        ArgsV.push_back(A->interpret(Frame));
+    return Frame.Runtime.call(*Frame.Runtime.getFunction(Callee), ArgsV);
+}
+
+InterpValue IfExprAST::interpret(InterpFrame &Frame) {
+    auto CondV = Cond->interpret(Frame);
+    if (CondV.I & 1)
+        Then->interpret(Frame);
+    else if (Else)
+        Else->interpret(Frame);
+    return InterpValue();
+}
+
+InterpValue ForExprAST::interpret(InterpFrame &Frame) {
+    Var->interpret(Frame);
+    while (true) {
+        auto LoopCond = End->interpret(Frame);
+        if (!(LoopCond.I & 1))
+            break;
+        Body->interpret(Frame);
+        if (Frame.Returned)
+            break;
+
+        long StepVal = Step ? Step->interpret(Frame).I : 1;
+        auto *Cur = Frame.lookup(scope, Var->getSymbol());
+        Cur->I += StepVal;
+        Frame.countBackEdge();
+    }
+    return InterpValue::getInt(0);
+}
+
+InterpValue VarExprAST::interpret(InterpFrame &Frame) {
+    auto V = (Init ? Init->interpret(Frame) : InterpValue()).convertTo(Type);
+    Frame.set(scope, Name, V);
+    return V;
+}
+
+InterpValue ReturnAST::interpret(InterpFrame &Frame) {
+    if (Var)
+        Frame.RetVal = Var->interpret(Frame).convertTo(Frame.Fn.RetType);
+    Frame.Returned = true;
+    return InterpValue();
+}
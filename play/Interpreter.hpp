@@ -0,0 +1,68 @@
+//
+//  Interpreter.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Interpreter_hpp
+#define Interpreter_hpp
+
+#include <cstdint>
+#include <utility>
+
+#include "llvm/ADT/DenseMap.h"
+
+#include "Symbol.hpp"
+
+class Scope;
+class VarType;
+class TieredRuntime;
+struct TieredFunction;
+
+/// InterpValue - A scalar as tier 0 sees it, the same bool, int and float the
+/// generated code works with.
+struct InterpValue {
+    enum KindTy : unsigned char { None, Bool, Int, Float };
+
+    KindTy Kind = None;
+    union {
+        long I = 0;
+        double F;
+    };
+
+    static InterpValue getBool(bool V) { InterpValue R; R.Kind = Bool; R.I = V; return R; }
+    static InterpValue getInt(long V) { InterpValue R; R.Kind = Int; R.I = V; return R; }
+    static InterpValue getFloat(double V) { InterpValue R; R.Kind = Float; R.F = V; return R; }
+
+    /// convertTo - Converts as a store or return of type T does in generated
+    /// code, None for void.
+    InterpValue convertTo(const VarType &T) const;
+    /// getBits - The value as passed in an i64 slot of a native entry.
+    uint64_t getBits() const;
+    static InterpValue fromBits(const VarType &T, uint64_t Bits);
+};
+
+/// InterpFrame - Locals of one interpreted call. Variables are keyed by the
+/// scope declaring them and found by walking up the scope chain, the way
+/// Scope::getVal resolves them at codegen time.
+class InterpFrame {
+    llvm::DenseMap<std::pair<const Scope *, Symbol>, InterpValue> Vars;
+
+public:
+    TieredRuntime &Runtime;
+    TieredFunction &Fn;
+    bool Returned = false;
+    InterpValue RetVal;
+
+    InterpFrame(TieredRuntime &runtime, TieredFunction &fn): Runtime(runtime), Fn(fn) {}
+
+    void set(const Scope *S, Symbol Name, InterpValue V) { Vars[{S, Name}] = V; }
+    /// lookup - The variable visible as Name from S, null if there is none.
+    InterpValue *lookup(const Scope *S, Symbol Name);
+    /// countBackEdge - Called on every loop iteration, loops make a function hot too.
+    void countBackEdge();
+};
+
+#endif /* Interpreter_hpp */
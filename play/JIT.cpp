@@ -0,0 +1,83 @@
+//
+//  JIT.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "JIT.hpp"
+#include "GlobalVars.hpp"
+
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace std;
+using namespace llvm;
+using namespace llvm::orc;
+
+static void LogJITError(Error Err) {
+    logAllUnhandledErrors(std::move(Err), ErrStream(), "LogError: ");
+}
+
+unique_ptr<PlayJIT> PlayJIT::Create(const string &CPU, const string &Features,
+                                    CodeGenOpt::Level CGLevel, OptimizeFunction Optimize) {
+    auto JTMB = JITTargetMachineBuilder::detectHost();
+    if (!JTMB) {
+        LogJITError(JTMB.takeError());
+        return nullptr;
+    }
+    JTMB->setCPU(CPU);
+    JTMB->getFeatures() = SubtargetFeatures(Features);
+    JTMB->setCodeGenOptLevel(CGLevel);
+
+    auto TM = JTMB->createTargetMachine();
+    if (!TM) {
+        LogJITError(TM.takeError());
+        return nullptr;
+    }
+
+    auto J = LLLazyJITBuilder().setJITTargetMachineBuilder(std::move(*JTMB)).create();
+    if (!J) {
+        LogJITError(J.takeError());
+        return nullptr;
+    }
+
+    auto Generator = DynamicLibrarySearchGenerator::GetForCurrentProcess((*J)->getDataLayout().getGlobalPrefix());
+    if (!Generator) {
+        LogJITError(Generator.takeError());
+        return nullptr;
+    }
+    (*J)->getMainJITDylib().setGenerator(std::move(*Generator));
+
+    if (Optimize) {
+        auto *OptTM = TM->get();
+        (*J)->getIRTransformLayer().setTransform(
+            [Optimize, OptTM](ThreadSafeModule TSM, const MaterializationResponsibility &R) -> Expected<ThreadSafeModule> {
+                auto Lock = TSM.getContextLock();
+                Optimize(*TSM.getModule(), *OptTM);
+                return std::move(TSM);
+            });
+    }
+
+    return unique_ptr<PlayJIT>(new PlayJIT(std::move(*TM), std::move(*J)));
+}
+
+bool PlayJIT::addModule(ThreadSafeModule TSM, bool Lazy) {
+    if (auto Err = Lazy ? J->addLazyIRModule(std::move(TSM)) : J->addIRModule(std::move(TSM))) {
+        LogJITError(std::move(Err));
+        return false;
+    }
+    return true;
+}
+
+JITTargetAddress PlayJIT::lookup(StringRef Name) {
+    auto Sym = J->lookup(Name);
+    if (!Sym) {
+        LogJITError(Sym.takeError());
+        return 0;
+    }
+    return Sym->getAddress();
+}
@@ -0,0 +1,58 @@
+//
+//  JIT.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef JIT_hpp
+#define JIT_hpp
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Target/TargetMachine.h"
+
+/// PlayJIT - An ORC LLLazyJIT session. Modules go in whole, but a function is
+/// only optimized and compiled the first time it is called, through a lazy
+/// reexport stub. Process symbols such as malloc and free resolve on demand.
+class PlayJIT {
+    /// TM - Built from the same JITTargetMachineBuilder as the JIT's own, for
+    /// the optimizer to see the target the code is compiled for.
+    std::unique_ptr<llvm::TargetMachine> TM;
+    std::unique_ptr<llvm::orc::LLLazyJIT> J;
+
+    PlayJIT(std::unique_ptr<llvm::TargetMachine> tm, std::unique_ptr<llvm::orc::LLLazyJIT> j)
+        : TM(std::move(tm)), J(std::move(j)) {}
+
+public:
+    using OptimizeFunction = std::function<void(llvm::Module &, llvm::TargetMachine &)>;
+
+    /// Create - A JIT for the host, with CPU and Features as for object files.
+    /// Optimize runs on each lazily extracted piece before it is compiled,
+    /// with a target machine for the host. Returns nullptr if the host target
+    /// isn't available.
+    static std::unique_ptr<PlayJIT> Create(const std::string &CPU, const std::string &Features,
+                                           llvm::CodeGenOpt::Level CGLevel, OptimizeFunction Optimize);
+
+    const llvm::DataLayout &getDataLayout() const { return J->getDataLayout(); }
+    /// getTargetMachine - The host target the JIT compiles for, to optimize
+    /// modules against before they are added.
+    llvm::TargetMachine &getTargetMachine() const { return *TM; }
+
+    /// addModule - Nothing is compiled yet, returns false on duplicate definitions.
+    /// A module added with Lazy false is compiled whole on the first lookup
+    /// into it, as it is, without the Optimize step.
+    bool addModule(llvm::orc::ThreadSafeModule TSM, bool Lazy = true);
+
+    /// lookup - Address of Name, compiling it if needed. Returns 0 if it can't be found.
+    llvm::JITTargetAddress lookup(llvm::StringRef Name);
+};
+
+#endif /* JIT_hpp */
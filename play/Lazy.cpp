@@ -0,0 +1,131 @@
+//
+//  Lazy.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Lazy.hpp"
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Transforms/IPO.h"
+
+using namespace std;
+using namespace llvm;
+
+static bool isTypeToken(Token T) {
+    return T == tok_type_void || T == tok_type_bool || T == tok_type_int || T == tok_type_float ||
+           T == tok_type_string || T == tok_type_object;
+}
+
+/// isCall - An identifier followed by '(', a call or a method call.
+static bool isCall(const SkimmedTokens &S, size_t i) {
+    return S.Tokens[i].Kind == tok_identifier && i + 1 < S.Tokens.size() && S.Tokens[i + 1].Kind == tok_left_paren;
+}
+
+/// getBareName - Methods are called by the name after "Class$".
+static StringRef getBareName(StringRef Name) {
+    return Name.substr(Name.find('$') + 1);
+}
+
+size_t LazyBuild::scanDefinition(const SkimmedTokens &S, size_t Name, vector<StringRef> &Calls) {
+    size_t i = Name + 2;
+    while (i < S.Tokens.size() && S.Tokens[i].Kind != tok_right_paren && S.Tokens[i].Kind != tok_eof)
+        i++;
+    if (i + 1 >= S.Tokens.size())
+        return i;
+    size_t Open = i + 1;
+    if (S.Tokens[Open].Kind != tok_left_bracket || S.Match[Open] == SkimmedTokens::NoMatch) {
+        // The parser can't step over a body without braces, it is always kept.
+        Calls.push_back(S.Tokens[Name].IdentifierStr);
+        return Open;
+    }
+    Bodies[S.Tokens[Name].IdentifierStr].push_back(make_pair((unsigned)Open, S.Match[Open]));
+    return S.Match[Open] + 1;
+}
+
+LazyBuild::LazyBuild(const SkimmedTokens &S, StringRef TopFuncName) {
+    auto &Toks = S.Tokens;
+    // Names called from the top level expressions, where the program starts.
+    vector<StringRef> Work = { TopFuncName };
+    size_t i = 0;
+    while (i < Toks.size() && Toks[i].Kind != tok_eof) {
+        auto Kind = Toks[i].Kind;
+        if (Kind == tok_class && i + 2 < Toks.size() && Toks[i + 2].Kind == tok_left_bracket &&
+            S.Match[i + 2] != SkimmedTokens::NoMatch) {
+            size_t Close = S.Match[i + 2];
+            for (size_t j = i + 3; j < Close;) {
+                if (isTypeToken(Toks[j].Kind) && isCall(S, j + 1)) {
+                    j = scanDefinition(S, j + 1, Work);
+                } else {
+                    // A method returning a class or a pointer isn't stepped over, its calls count.
+                    if (isCall(S, j))
+                        Work.push_back(Toks[j].IdentifierStr);
+                    j++;
+                }
+            }
+            i = Close + 1;
+        } else if (isTypeToken(Kind) && i + 1 < Toks.size() && isCall(S, i + 1)) {
+            i = scanDefinition(S, i + 1, Work);
+        } else {
+            if (isCall(S, i))
+                Work.push_back(Toks[i].IdentifierStr);
+            i++;
+        }
+    }
+
+    while (!Work.empty()) {
+        auto Name = Work.back();
+        Work.pop_back();
+        if (!Reachable.insert(Name).second)
+            continue;
+        auto B = Bodies.find(Name);
+        if (B == Bodies.end())
+            continue;
+        for (auto &Range : B->second) {
+            for (size_t j = Range.first + 1; j < Range.second; j++) {
+                if (isCall(S, j))
+                    Work.push_back(Toks[j].IdentifierStr);
+            }
+        }
+    }
+}
+
+bool LazyBuild::skipsBody(const PrototypeAST &P) {
+    auto Name = getBareName(P.getName());
+    return Bodies.count(Name) && !Reachable.count(Name);
+}
+
+void LazyBuild::countBody(const FunctionAST &F) {
+    if (F.getBody())
+        NumParsed++;
+    else
+        NumSkipped++;
+}
+
+void LazyBuild::addFunction(FunctionAST *F) {
+    countBody(*F);
+    F->codegen();
+}
+
+void LazyBuild::addClass(ClassDeclAST *C) {
+    for (size_t i = 0; i < C->getNumMethods(); i++)
+        countBody(*C->getMethod(i));
+    C->codegen();
+}
+
+void LazyBuild::internalize(Module &M, StringRef TopFuncName) {
+    for (auto &F : M) {
+        if (!F.isDeclaration() && F.getName() != TopFuncName)
+            F.setLinkage(GlobalValue::InternalLinkage);
+    }
+    legacy::PassManager PM;
+    PM.add(createGlobalDCEPass());
+    PM.run(M);
+}
+
+void LazyBuild::printStats(raw_ostream &OS) const {
+    OS << "### Lazy Stats ###\n";
+    OS << "bodies parsed: " << NumParsed << ", skipped: " << NumSkipped << "\n";
+}
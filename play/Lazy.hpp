@@ -0,0 +1,55 @@
+//
+//  Lazy.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Lazy_hpp
+#define Lazy_hpp
+
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "Lexer.hpp"
+#include "Parser.hpp"
+
+/// LazyBuild - Parses and generates only the functions reachable from the
+/// top level expressions. The skimmed tokens give the braced body of every
+/// function and method and the names called in it, and a name called from
+/// reachable code keeps every function and method of that name. The parser
+/// steps over the other bodies, those functions are only declared.
+///
+/// Reachability is by name only, what it keeps that is still unused goes in
+/// internalize.
+class LazyBuild : public ItemBuilder {
+    /// Token ranges of the braced bodies, by function or method name.
+    llvm::StringMap<std::vector<std::pair<unsigned, unsigned>>> Bodies;
+    llvm::StringSet<> Reachable;
+    unsigned NumParsed = 0;
+    unsigned NumSkipped = 0;
+
+    size_t scanDefinition(const SkimmedTokens &S, size_t Name, std::vector<llvm::StringRef> &Calls);
+    void countBody(const FunctionAST &F);
+
+public:
+    LazyBuild(const SkimmedTokens &S, llvm::StringRef TopFuncName);
+
+    bool skipsBody(const PrototypeAST &P) override;
+    void addFunction(FunctionAST *F) override;
+    void addClass(ClassDeclAST *C) override;
+
+    /// internalize - Gives every function but TopFuncName internal linkage
+    /// and deletes the ones nothing calls.
+    static void internalize(llvm::Module &M, llvm::StringRef TopFuncName);
+
+    void printStats(llvm::raw_ostream &OS) const;
+};
+
+#endif /* Lazy_hpp */
@@ -7,143 +7,267 @@
 //
 
 #include "Lexer.hpp"
+#include "SPSCQueue.hpp"
 #include <iostream>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
 
 using namespace std;
 
+struct Keyword {
+    const char *Name;
+    size_t Len;
+    Token Tok;
+};
+
+static constexpr size_t KeywordLen(const char *Str) {
+    size_t Len = 0;
+    while (Str[Len])
+        Len++;
+    return Len;
+}
+
+#define KEYWORD(Name, Tok) { Name, KeywordLen(Name), Tok }
+
+constexpr Keyword Keywords[] = {
+    KEYWORD("extern", tok_extern),
+    KEYWORD("if", tok_if),
+    KEYWORD("then", tok_then),
+    KEYWORD("else", tok_else),
+    KEYWORD("for", tok_for),
+    KEYWORD("in", tok_in),
+    KEYWORD("unary", tok_unary),
+    KEYWORD("binary", tok_binary),
+    KEYWORD("var", tok_var),
+    KEYWORD("void", tok_type_void),
+    KEYWORD("bool", tok_type_bool),
+    KEYWORD("int", tok_type_int),
+    KEYWORD("float", tok_type_float),
+    KEYWORD("string", tok_type_string),
+    KEYWORD("class", tok_class),
+    KEYWORD("new", tok_new),
+    KEYWORD("delete", tok_del),
+    KEYWORD("return", tok_ret),
+};
+
+#undef KEYWORD
+
+constexpr size_t NumKeywords = sizeof(Keywords) / sizeof(Keywords[0]);
+constexpr size_t KeywordMinLen = 2;
+constexpr size_t KeywordMaxLen = 6;
+constexpr size_t KeywordSlots = 64;
+
+// Length, first and last char are enough to tell all keywords apart,
+// the factors were searched offline and are checked by the static_assert below.
+static constexpr size_t KeywordHash(const char *Str, size_t Len) {
+    return (Len + (unsigned char)Str[0] * 3 + (unsigned char)Str[Len - 1] * 26) & (KeywordSlots - 1);
+}
+
+struct KeywordTable {
+    signed char Slots[KeywordSlots];
+    bool Perfect;
+};
+
+static constexpr KeywordTable BuildKeywordTable() {
+    KeywordTable T = {{}, true};
+    for (size_t i = 0; i < KeywordSlots; i++)
+        T.Slots[i] = -1;
+    for (size_t i = 0; i < NumKeywords; i++) {
+        auto &K = Keywords[i];
+        auto H = KeywordHash(K.Name, K.Len);
+        if (T.Slots[H] != -1 || K.Len < KeywordMinLen || K.Len > KeywordMaxLen)
+            T.Perfect = false;
+        T.Slots[H] = (signed char)i;
+    }
+    return T;
+}
+
+constexpr KeywordTable TheKeywordTable = BuildKeywordTable();
+static_assert(TheKeywordTable.Perfect, "keyword hash has collisions, pick new factors for KeywordHash");
+
+Token getKeywordToken(const char *Str, size_t Len) {
+    if (Len < KeywordMinLen || Len > KeywordMaxLen)
+        return tok_identifier;
+    auto Idx = TheKeywordTable.Slots[KeywordHash(Str, Len)];
+    if (Idx < 0)
+        return tok_identifier;
+    auto &K = Keywords[Idx];
+    if (K.Len != Len || memcmp(K.Name, Str, Len) != 0)
+        return tok_identifier;
+    return K.Tok;
+}
+
 Token Lexer::GetChar() {
-    if (Index >= TheCode.length())
-        return (Token)EOF;
-    Token CurChar = (Token)TheCode.at(Index++);
+    if (Index >= TheCode.size()) {
+        if (NextBuffer >= Buffers.size())
+            return (Token)EOF;
+        TheCode = Buffers[NextBuffer++];
+        Index = 0;
+        ScanLoc = {1, 0};
+        // The end of a buffer separates tokens like a line break.
+        return tok_newline;
+    }
+    Token CurChar = (Token)TheCode[Index++];
 //    cout << "getchar [" << string(1, CurChar) << "]" << endl;
 
     if (CurChar == tok_newline || CurChar == tok_return) {
-        CurLoc.Line++;
-        CurLoc.Col = 0;
+        ScanLoc.Line++;
+        ScanLoc.Col = 0;
     } else {
-        CurLoc.Col++;
+        ScanLoc.Col++;
     }
 
     return CurChar;
 }
 
-Token Lexer::getNextToken(unsigned ForwardStep) {
-    if (ForwardStep == 0) {
-        while (isspace(LastChar)) {
-            LastChar = GetChar();
-        }
+const unsigned SkimmedTokens::NoMatch;
 
-        if (isalpha(LastChar)) {
-            IdentifierStr = LastChar;
-            while (isalnum(LastChar = GetChar())) {
-                IdentifierStr += LastChar;
-            }
-
-            if (IdentifierStr == "extern")
-                return CurTok = tok_extern;
-            if (IdentifierStr == "exit")
-                exit(0);
-            if (IdentifierStr == "if")
-                return CurTok = tok_if;
-            if (IdentifierStr == "then")
-                return CurTok = tok_then;
-            if (IdentifierStr == "else")
-                return CurTok = tok_else;
-            if (IdentifierStr == "for")
-                return CurTok = tok_for;
-            if (IdentifierStr == "in")
-                return CurTok = tok_in;
-            if (IdentifierStr == "unary")
-                return CurTok = tok_unary;
-            if (IdentifierStr == "binary")
-                return CurTok = tok_binary;
-            if (IdentifierStr == "var")
-                return CurTok = tok_var;
-            if (IdentifierStr == "void")
-                return CurTok = tok_type_void;
-            if (IdentifierStr == "bool")
-                return CurTok = tok_type_bool;
-            if (IdentifierStr == "int")
-                return CurTok = tok_type_int;
-            if (IdentifierStr == "float")
-                return CurTok = tok_type_float;
-            if (IdentifierStr == "string")
-                return CurTok = tok_type_string;
-            if (IdentifierStr == "class")
-                return CurTok = tok_class;
-            if (IdentifierStr == "new")
-                return CurTok = tok_new;
-            if (IdentifierStr == "delete")
-                return CurTok = tok_del;
-            if (IdentifierStr == "return")
-                return CurTok = tok_ret;
-
-            return CurTok = tok_identifier;
+SkimmedTokens SkimmedTokens::skim(vector<llvm::StringRef> Buffers) {
+    SkimmedTokens S;
+    vector<unsigned> Open;
+    Lexer L(std::move(Buffers));
+    do {
+        L.getNextToken();
+        unsigned Index = (unsigned)S.Tokens.size();
+        S.Tokens.push_back(L.getCurTokenInfo());
+        S.Match.push_back(NoMatch);
+        if (L.getCurToken() == tok_left_bracket) {
+            Open.push_back(Index);
+        } else if (L.getCurToken() == tok_right_bracket && !Open.empty()) {
+            S.Match[Open.back()] = Index;
+            Open.pop_back();
         }
+    } while (L.getCurToken() != tok_eof);
+    return S;
+}
 
-        if (LastChar == tok_dot) {
-            LastChar = GetChar();
-            return CurTok = tok_dot;
-        }
+bool Lexer::skipBracedBody() {
+    // Without lookahead the current token is the last one taken.
+    if (!Skimmed || LookaheadCount || Cur.Kind != tok_left_bracket || !SkimPos)
+        return false;
+    unsigned Close = Skimmed->Match[SkimPos - 1];
+    if (Close == SkimmedTokens::NoMatch)
+        return false;
+    SkimPos = Close + 1;
+    LexToken(Cur);
+    return true;
+}
 
-        if (isdigit(LastChar) || LastChar == tok_dot) {
-            string NumStr;
-//            if (LastChar == tok_sub) {
-//                NumStr += LastChar;
-//                Token x = GetChar();
-//                while (x == tok_space) {
-//                    x = GetChar();
-//                }
-//                LastChar = x;
-//            }
-            do {
-                NumStr += LastChar;
-                LastChar = GetChar();
-            } while (isdigit(LastChar) || LastChar == tok_dot);
-
-            if (NumStr.find(tok_dot) == string::npos) {
-                IntegerVal = stol(NumStr);
-                return CurTok = tok_integer_literal;
-            } else {
-                FloatVal = stod(NumStr);
-                return CurTok = tok_float_literal;
-            }
+Token Lexer::LexToken(TokenInfo &Tok) {
+    NumTokens++;
+    if (Skimmed) {
+        // tok_eof is last, and repeats.
+        Tok = Skimmed->Tokens[std::min(SkimPos, Skimmed->Tokens.size() - 1)];
+        if (SkimPos < Skimmed->Tokens.size())
+            SkimPos++;
+        if (Symbols && Tok.Kind == tok_identifier)
+            Tok.IdentifierSym = Symbols->intern(Tok.IdentifierStr);
+        return Tok.Kind;
+    }
+    if (Source) {
+        // The lexer thread stops after tok_eof, which then repeats.
+        if (SourceEnded) {
+            Tok = TokenInfo();
+            Tok.Kind = tok_eof;
+            return Tok.Kind;
         }
+        Tok = Source->pop();
+        SourceEnded = Tok.Kind == tok_eof;
+        // Interned here, the table belongs to this thread.
+        if (Symbols && Tok.Kind == tok_identifier)
+            Tok.IdentifierSym = Symbols->intern(Tok.IdentifierStr);
+        return Tok.Kind;
+    }
+    Tok.Kind = ScanToken(Tok);
+    Tok.Loc = ScanLoc;
+    return Tok.Kind;
+}
 
-        if (LastChar == tok_hash) {
-            do {
-                LastChar = GetChar();
-            } while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
+Token Lexer::ScanToken(TokenInfo &Tok) {
+    while (isspace(LastChar)) {
+        LastChar = GetChar();
+    }
 
-            if (LastChar != EOF) {
-                return getNextToken();
-            }
+    if (isalpha(LastChar)) {
+        const char *Start = TheCode.data() + Index - 1;
+        size_t Len = 1;
+        while (isalnum(LastChar = GetChar())) {
+            Len++;
         }
+        Tok.IdentifierStr = llvm::StringRef(Start, Len);
 
-        if (LastChar == EOF) {
-            return CurTok = tok_eof;
-        }
+        Token Keyword = getKeywordToken(Tok.IdentifierStr.data(), Tok.IdentifierStr.size());
+        if (Symbols && Keyword == tok_identifier)
+            Tok.IdentifierSym = Symbols->intern(Tok.IdentifierStr);
+
+        return Keyword;
+    }
 
-        Token ThisChar = LastChar;
+    if (LastChar == tok_dot) {
         LastChar = GetChar();
-        return CurTok = ThisChar;
+        return tok_dot;
+    }
+
+    if (isdigit(LastChar) || LastChar == tok_dot) {
+        string NumStr;
+//        if (LastChar == tok_sub) {
+//            NumStr += LastChar;
+//            Token x = GetChar();
+//            while (x == tok_space) {
+//                x = GetChar();
+//            }
+//            LastChar = x;
+//        }
+        do {
+            NumStr += LastChar;
+            LastChar = GetChar();
+        } while (isdigit(LastChar) || LastChar == tok_dot);
+
+        if (NumStr.find(tok_dot) == string::npos) {
+            Tok.IntegerVal = stol(NumStr);
+            return tok_integer_literal;
+        } else {
+            Tok.FloatVal = stod(NumStr);
+            return tok_float_literal;
+        }
     }
 
-    Token SavedLastChar = LastChar;
-    SourceLocation SavedCurLoc = CurLoc;
-    Token SavedCurTok = CurTok;
-    string::size_type SavedIndex = Index;
-    string SavedIdentifierStr = IdentifierStr;
+    if (LastChar == tok_hash) {
+        do {
+            LastChar = GetChar();
+        } while (LastChar != EOF && LastChar != '\n' && LastChar != '\r');
+
+        if (LastChar != EOF) {
+            return ScanToken(Tok);
+        }
+    }
 
-    Token Tok = (Token)0;
-    for (unsigned i = 0; i < ForwardStep; i++) {
-        Tok = getNextToken();
+    if (LastChar == EOF) {
+        return tok_eof;
     }
-    LastChar = SavedLastChar;
-    CurLoc = SavedCurLoc;
-    CurTok = SavedCurTok;
-    Index = SavedIndex;
-    IdentifierStr = SavedIdentifierStr;
 
-    return Tok;
+    Token ThisChar = LastChar;
+    LastChar = GetChar();
+    return ThisChar;
+}
+
+Token Lexer::getNextToken() {
+    if (LookaheadCount == 0)
+        return LexToken(Cur);
+
+    Cur = Lookahead[LookaheadHead];
+    LookaheadHead = (LookaheadHead + 1) % MaxLookahead;
+    LookaheadCount--;
+
+    return Cur.Kind;
+}
+
+Token Lexer::peekToken(unsigned Step) {
+    assert(Step > 0 && Step <= MaxLookahead && "lookahead out of range");
+    while (LookaheadCount < Step) {
+        LexToken(Lookahead[(LookaheadHead + LookaheadCount) % MaxLookahead]);
+        LookaheadCount++;
+    }
+    return Lookahead[(LookaheadHead + Step - 1) % MaxLookahead].Kind;
 }
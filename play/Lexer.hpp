@@ -9,10 +9,18 @@
 #ifndef Lexer_hpp
 #define Lexer_hpp
 
+#include <cstdio>
 #include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "Symbol.hpp"
 
 using namespace std;
 
+template <typename T> class SPSCQueue;
+
 typedef enum Token {
     tok_eof = -1,
     tok_class = -2,
@@ -96,33 +104,102 @@ static string tok_tos(Token t) {
     }
 }
 
+/// getKeywordToken - Classify an identifier, returns tok_identifier if it isn't a keyword.
+Token getKeywordToken(const char *Str, size_t Len);
+
 struct SourceLocation {
     int Line;
     int Col;
 };
 
+/// TokenInfo - A fully lexed token with its literal payload.
+struct TokenInfo {
+    Token Kind = (Token)0;
+    SourceLocation Loc = {1, 0};
+    llvm::StringRef IdentifierStr; // points into the source buffer
+    Symbol IdentifierSym; // interned when the lexer has a symbol table
+    long IntegerVal = 0;
+    double FloatVal = 0;
+};
+
+/// SkimmedTokens - A whole file lexed ahead of parsing, read by the parsers
+/// of every shard at once. Match holds the index of the closing brace of
+/// every opening one, so a body can be stepped over without reading it.
+struct SkimmedTokens {
+    static const unsigned NoMatch = ~0u;
+
+    vector<TokenInfo> Tokens;
+    vector<unsigned> Match;
+
+    /// skim - Lexes Buffers to the end, identifiers are left for each parser to intern.
+    static SkimmedTokens skim(vector<llvm::StringRef> Buffers);
+};
+
 class Lexer {
-public:
+    static const unsigned MaxLookahead = 4;
 
-    SourceLocation CurLoc = {1, 0};
+    // The current token, and the ones lexed ahead of it by peekToken.
+    TokenInfo Cur;
+    TokenInfo Lookahead[MaxLookahead];
+    unsigned LookaheadHead = 0;
+    unsigned LookaheadCount = 0;
 
-    Token CurTok = (Token)0;
-    string::size_type Index = 0;
-    Token LastChar = tok_space;
+    // Buffers are scanned back to back, each with its own line numbers.
+    vector<llvm::StringRef> Buffers;
+    size_t NextBuffer = 0;
+    SourceLocation ScanLoc = {1, 0};
 
-    string IdentifierStr;
-    long IntegerVal;
-    double FloatVal;
-    string TheCode;
+    // Identifiers are interned here as they are scanned, may be null.
+    SymbolTable *Symbols;
 
-    Lexer(string &code): TheCode(code) {}
-    Token getNextToken(unsigned ForwardStep = 0);
+    // Tokens scanned on a lexer thread, taken instead of scanning when set.
+    SPSCQueue<TokenInfo> *Source = nullptr;
+    bool SourceEnded = false;
+    // Tokens skimmed before parsing, read from here when set.
+    const SkimmedTokens *Skimmed = nullptr;
+    size_t SkimPos = 0;
+
+    size_t NumTokens = 0;
+
+    Token LexToken(TokenInfo &Tok);
+    Token ScanToken(TokenInfo &Tok);
+
+public:
+
+    size_t Index = 0;
+    Token LastChar = tok_space;
+
+    llvm::StringRef TheCode;
+
+    Lexer(vector<llvm::StringRef> buffers, SymbolTable *symbols = nullptr, SPSCQueue<TokenInfo> *source = nullptr,
+          const SkimmedTokens *skimmed = nullptr)
+    : Buffers(std::move(buffers)), Symbols(symbols), Source(source), Skimmed(skimmed) {}
+    Lexer(llvm::StringRef code, SymbolTable *symbols = nullptr): Buffers(1, code), Symbols(symbols) {}
+    /// appendBuffer - Scanned after the current buffers, picks up again after tok_eof.
+    void appendBuffer(llvm::StringRef Buffer) {
+        Buffers.push_back(Buffer);
+        if (LastChar == (Token)EOF)
+            LastChar = tok_space;
+    }
+    Token getNextToken();
+    /// peekToken - Kind of the Step-th token after the current one, lexed once and kept until consumed.
+    Token peekToken(unsigned Step);
     Token getCurToken() {
-        return CurTok;
+        return Cur.Kind;
+    }
+    /// skipBracedBody - With skimmed tokens, moves from the current '{' to the
+    /// token after its '}'. Returns false, and moves nowhere, when it can't.
+    bool skipBracedBody();
+    SourceLocation getCurLoc() {
+        return Cur.Loc;
+    }
+    const TokenInfo &getCurTokenInfo() const {
+        return Cur;
     }
     Token GetChar();
 
     Token getVarType() {
+        Token CurTok = Cur.Kind;
         if (CurTok == tok_type_bool ||
             CurTok == tok_type_int ||
             CurTok == tok_type_float ||
@@ -133,14 +210,21 @@ public:
         }
         return (Token)0;
     }
-    string &getIdentifier() {
-        return IdentifierStr;
+    llvm::StringRef getIdentifier() {
+        return Cur.IdentifierStr;
+    }
+    Symbol getSymbol() {
+        return Cur.IdentifierSym;
+    }
+    /// getNumTokens - Tokens scanned so far, including the ones peeked at.
+    size_t getNumTokens() const {
+        return NumTokens;
     }
     long getInt() {
-        return IntegerVal;
+        return Cur.IntegerVal;
     }
     double getFloat() {
-        return FloatVal;
+        return Cur.FloatVal;
     }
 };
 
@@ -0,0 +1,85 @@
+//
+//  Parallel.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Parallel.hpp"
+#include "GlobalVars.hpp"
+
+#include <algorithm>
+
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+using namespace std;
+using namespace llvm;
+
+void ShardBuild::endItem(bool Generated) {
+    unsigned Index = NumItems++;
+    // Every item starts on a module of its own, with the declarations of the
+    // externs since the last item, whichever shard generates it.
+    auto M = TheParser->takeModule();
+    TheParser->InitializeModuleAndPassManager();
+    if (!Generated)
+        return;
+
+    if (verifyModule(*M, &ErrStream())) {
+        cerr << "LogError: invalid code in item " << Index << endl;
+        Failed = true;
+        return;
+    }
+    Prepare(*M);
+
+    Items.push_back({ Index, {} });
+    raw_svector_ostream OS(Items.back().Bitcode);
+    WriteBitcodeToFile(*M, OS);
+}
+
+void ShardBuild::addFunction(FunctionAST *F) {
+    bool Generated = owns();
+    if (Generated)
+        F->codegen();
+    else
+        F->declare();
+    endItem(Generated);
+}
+
+void ShardBuild::addClass(ClassDeclAST *C) {
+    bool Generated = owns();
+    if (Generated)
+        C->codegen();
+    else
+        C->declare();
+    endItem(Generated);
+}
+
+bool linkShardItems(vector<vector<ShardItem>> &Shards, Module &M) {
+    vector<ShardItem *> Items;
+    for (auto &S : Shards) {
+        for (auto &Item : S)
+            Items.push_back(&Item);
+    }
+    std::sort(Items.begin(), Items.end(), [](ShardItem *A, ShardItem *B) { return A->Index < B->Index; });
+
+    Linker L(M);
+    for (auto *Item : Items) {
+        MemoryBufferRef Buf(StringRef(Item->Bitcode.data(), Item->Bitcode.size()), M.getName());
+        auto ItemM = parseBitcodeFile(Buf, M.getContext());
+        if (!ItemM) {
+            logAllUnhandledErrors(ItemM.takeError(), ErrStream(), "LogError: ");
+            return false;
+        }
+        if (L.linkInModule(std::move(*ItemM))) {
+            cerr << "LogError: can't link item " << Item->Index << endl;
+            return false;
+        }
+        // Done with it, the linked module holds the code now.
+        Item->Bitcode = {};
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+//
+//  Parallel.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Parallel_hpp
+#define Parallel_hpp
+
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Module.h"
+
+#include "BuildSupport.hpp"
+#include "Parser.hpp"
+
+/// ShardItem - One generated item as bitcode, to cross over into the
+/// context of the module it is linked into.
+struct ShardItem {
+    unsigned Index;
+    llvm::SmallVector<char, 0> Bitcode;
+};
+
+/// ShardBuild - One of NumShards threads compiling a file. Each parses the
+/// whole file with a parser and context of its own, and generates every
+/// NumShards-th top level item, the others it only declares. Every item is
+/// generated into a module of its own and optimized alone, so its code is
+/// the same for any number of shards.
+class ShardBuild : public ItemBuilder {
+    unsigned Shard;
+    unsigned NumShards;
+    PrepareFunction Prepare;
+    unsigned NumItems = 0;
+    std::vector<ShardItem> Items;
+    bool Failed = false;
+
+    bool owns() const { return NumItems % NumShards == Shard; }
+    void endItem(bool Generated);
+
+public:
+    /// Prepare sets up the module of each item for the target and optimizes it.
+    ShardBuild(unsigned shard, unsigned numShards, PrepareFunction prepare)
+        : Shard(shard), NumShards(numShards), Prepare(std::move(prepare)) {}
+
+    /// skipsBody - Bodies of the items of other shards are stepped over.
+    bool skipsBody(const PrototypeAST &P) override { return !owns(); }
+    void addFunction(FunctionAST *F) override;
+    void addClass(ClassDeclAST *C) override;
+
+    /// takeItems - The items generated, in source order.
+    std::vector<ShardItem> takeItems() { return std::move(Items); }
+    /// failed - An item didn't verify.
+    bool failed() const { return Failed; }
+};
+
+/// linkShardItems - Links the items of every shard into M in source order,
+/// the output doesn't depend on how the items were sharded. Returns false
+/// if an item can't be read or linked.
+bool linkShardItems(std::vector<std::vector<ShardItem>> &Shards, llvm::Module &M);
+
+#endif /* Parallel_hpp */
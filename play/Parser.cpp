@@ -8,44 +8,50 @@
 
 #include "Parser.hpp"
 #include "GlobalVars.hpp"
+#include "Tiered.hpp"
+
+#include "llvm/Support/SaveAndRestore.h"
 
 using namespace llvm;
 using namespace std;
 
 #define make_unique std::make_unique
 
-unique_ptr<Parser> TheParser;
+thread_local Parser *TheParser = nullptr;
 
 string FunctionAST::dumpJSON() {
-    return FormatString("{`type`: `Function`, `Prototype`: %s, `Body`: %s}", Proto->dumpJSON().c_str(), Body->dumpJSON().c_str());
+    string BodyJSON = Body ? Body->dumpJSON() : "null";
+    return FormatString("{`type`: `Function`, `Prototype`: %s, `Body`: %s}", Proto->dumpJSON().c_str(), BodyJSON.c_str());
 }
 
-ExprAST::ExprAST(shared_ptr<Scope> scope) {
+ExprAST::ExprAST(Scope *scope) {
     this->scope = scope;
     this->Loc = TheParser->getCurLoc();
 }
 
 Token Parser::getNextToken() {
+    if (Items)
+        Items->addToken(TheLexer->getCurTokenInfo());
     return TheLexer->getNextToken();
 }
 
-unique_ptr<ExprAST> Parser::ParseIntegerLiteral(shared_ptr<Scope> scope) {
-    auto Result = make_unique<IntegerLiteralAST>(scope, (long)TheLexer->IntegerVal);
+ASTPtr<ExprAST> Parser::ParseIntegerLiteral(Scope *scope) {
+    auto Result = NodeContext->create<IntegerLiteralAST>(scope, (long)TheLexer->getInt());
     getNextToken();
 
     SkipColon();
     return std::move(Result);
 }
 
-unique_ptr<ExprAST> Parser::ParseFloatLiteral(shared_ptr<Scope> scope) {
-    auto Result = make_unique<FloatLiteralAST>(scope, TheLexer->FloatVal);
+ASTPtr<ExprAST> Parser::ParseFloatLiteral(Scope *scope) {
+    auto Result = NodeContext->create<FloatLiteralAST>(scope, TheLexer->getFloat());
     getNextToken();
 
     SkipColon();
     return std::move(Result);
 }
 
-unique_ptr<ExprAST> Parser::ParseParenExpr(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseParenExpr(Scope *scope) {
     getNextToken();
     auto V = ParseExpr(scope);
     if (!V)
@@ -61,25 +67,25 @@ unique_ptr<ExprAST> Parser::ParseParenExpr(shared_ptr<Scope> scope) {
     return V;
 }
 
-std::unique_ptr<ExprAST> Parser::ParseIdentifierExpr(shared_ptr<Scope> scope) {
-    std::string IdName = TheLexer->IdentifierStr;
+ASTPtr<ExprAST> Parser::ParseIdentifierExpr(Scope *scope) {
+    Symbol IdName = TheLexer->getSymbol();
 
-    SourceLocation LitLoc = TheLexer->CurLoc;
+    SourceLocation LitLoc = TheLexer->getCurLoc();
 
     getNextToken(); // eat identifier.
 
     if (getCurTok() != tok_left_paren) {// Simple variable ref.
         SkipColon();
-        return make_unique<VariableExprAST>(scope, LitLoc, IdName);
+        return NodeContext->create<VariableExprAST>(scope, LitLoc, IdName);
     }
 
     // Call.
     getNextToken(); // eat (
-    std::vector<std::unique_ptr<ExprAST>> Args;
+    std::vector<ASTPtr<ExprAST>> Args;
     if (getCurTok() != tok_right_paren) {
         while (true) {
             if (auto Arg = ParseExpr(scope)) {
-                auto ArgV = make_unique<RightValueAST>(scope, std::move(Arg));
+                auto ArgV = NodeContext->create<RightValueAST>(scope, std::move(Arg));
                 Args.push_back(std::move(ArgV));
             }
             else
@@ -100,14 +106,14 @@ std::unique_ptr<ExprAST> Parser::ParseIdentifierExpr(shared_ptr<Scope> scope) {
 
     SkipColon();
 
-    return make_unique<CallExprAST>(scope, TheLexer->CurLoc, IdName, std::move(Args));
+    return NodeContext->create<CallExprAST>(scope, TheLexer->getCurLoc(), IdName, std::move(Args));
 }
 
-unique_ptr<ExprAST> Parser::ParsePrimary(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParsePrimary(Scope *scope) {
     switch (getCurTok()) {
         case tok_identifier:
-            if (scope->getClass(TheLexer->IdentifierStr)) {
-                if (TheLexer->getNextToken(1) == tok_left_paren) { // constructor
+            if (scope->getClass(TheLexer->getSymbol())) {
+                if (TheLexer->peekToken(1) == tok_left_paren) { // constructor
                     return ParseIdentifierExpr(scope);
                 }
                 return ParseVarExpr(scope);
@@ -155,18 +161,20 @@ int Parser::GetTokenPrecedence() {
     return TokPrec;
 }
 
-unique_ptr<ExprAST> Parser::ParseExpr(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseExpr(Scope *scope) {
     if (getCurTok() == tok_left_bracket) {
 
         getNextToken();
 
-        vector<unique_ptr<ExprAST>> Exprs;
-        auto localScope = make_shared<Scope>(scope);
+        vector<ASTPtr<ExprAST>> Exprs;
+        auto localScope = NewScope(scope);
         while (true) {
             if (getCurTok() == tok_right_bracket) {
                 getNextToken();
                 break;
             }
+            if (getCurTok() == tok_eof)
+                return LogError("expected '}'");
             auto Expr = ParseExpr(localScope);
             if (!Expr)
                 return nullptr;
@@ -176,7 +184,7 @@ unique_ptr<ExprAST> Parser::ParseExpr(shared_ptr<Scope> scope) {
             Exprs.push_back(std::move(Expr));
         }
 
-        return make_unique<CompoundExprAST>(localScope, std::move(Exprs));
+        return NodeContext->create<CompoundExprAST>(localScope, std::move(Exprs));
     }
 
     auto LHS = ParseUnary(scope);
@@ -188,9 +196,9 @@ unique_ptr<ExprAST> Parser::ParseExpr(shared_ptr<Scope> scope) {
     return Bin;
 }
 
-unique_ptr<ExprAST> Parser::ParseBinOpRHS(shared_ptr<Scope> scope,
+ASTPtr<ExprAST> Parser::ParseBinOpRHS(Scope *scope,
                                          int ExprPrec,
-                                         unique_ptr<ExprAST> LHS) {
+                                         ASTPtr<ExprAST> LHS) {
     while (true) {
         int TokPrec = GetTokenPrecedence();
 
@@ -199,7 +207,7 @@ unique_ptr<ExprAST> Parser::ParseBinOpRHS(shared_ptr<Scope> scope,
         }
 
         char BinOp = getCurTok();
-        SourceLocation BinLoc = TheLexer->CurLoc;
+        SourceLocation BinLoc = TheLexer->getCurLoc();
 
         if (getCurTok() == tok_dot) {
             getNextToken();
@@ -208,7 +216,7 @@ unique_ptr<ExprAST> Parser::ParseBinOpRHS(shared_ptr<Scope> scope,
                 return LogError("expected identifier after '.'");
             }
 
-            string MemName = TheLexer->IdentifierStr;
+            Symbol MemName = TheLexer->getSymbol();
             getNextToken();
 
             if (getCurTok() == tok_equal) {
@@ -216,22 +224,22 @@ unique_ptr<ExprAST> Parser::ParseBinOpRHS(shared_ptr<Scope> scope,
 
                 auto RHS = ParseExpr(scope);
                 if (!RHS)
-                    LogError("expected expression after member assignment");
+                    return LogError("expected expression after member assignment");
 
-                auto RV = make_unique<RightValueAST>(scope, std::move(RHS));
-//                auto LV = make_unique<RightValueAST>(scope, std::move(LHS));
+                auto RV = NodeContext->create<RightValueAST>(scope, std::move(RHS));
+//                auto LV = NodeContext->create<RightValueAST>(scope, std::move(LHS));
 
-                return make_unique<MemberAccessAST>(scope, std::move(LHS), MemName, std::move(RV));
+                return NodeContext->create<MemberAccessAST>(scope, std::move(LHS), MemName, std::move(RV));
             }
 
             if (getCurTok() == tok_left_paren) { // method call
                 getNextToken();
-                vector<unique_ptr<ExprAST>> Args;
+                vector<ASTPtr<ExprAST>> Args;
 //                Args.push_back(std::move(LHS));
                 if (getCurTok() != tok_right_paren) {
                     while (true) {
                         if (auto Arg = ParseExpr(scope)) {
-                            auto ArgV = make_unique<RightValueAST>(scope, std::move(Arg));
+                            auto ArgV = NodeContext->create<RightValueAST>(scope, std::move(Arg));
                             Args.push_back(std::move(ArgV));
                         }
                         else
@@ -249,13 +257,13 @@ unique_ptr<ExprAST> Parser::ParseBinOpRHS(shared_ptr<Scope> scope,
 
                 getNextToken();
 
-                return make_unique<MethodCallAST>(scope, std::move(LHS), MemName, std::move(Args));
+                return NodeContext->create<MethodCallAST>(scope, std::move(LHS), MemName, std::move(Args));
             }
 
             SkipColon();
 
-//            auto LV = make_unique<RightValueAST>(scope, std::move(LHS));
-            return make_unique<MemberAccessAST>(scope, std::move(LHS), MemName);
+//            auto LV = NodeContext->create<RightValueAST>(scope, std::move(LHS));
+            return NodeContext->create<MemberAccessAST>(scope, std::move(LHS), MemName);
         }
 
         getNextToken();
@@ -273,19 +281,19 @@ unique_ptr<ExprAST> Parser::ParseBinOpRHS(shared_ptr<Scope> scope,
             }
         }
 
-        auto LV = make_unique<RightValueAST>(scope, std::move(LHS));
-        auto RV = make_unique<RightValueAST>(scope, std::move(RHS));
+        auto LV = NodeContext->create<RightValueAST>(scope, std::move(LHS));
+        auto RV = NodeContext->create<RightValueAST>(scope, std::move(RHS));
 
-        LHS = make_unique<BinaryExprAST>(scope, BinLoc, BinOp, std::move(LV), std::move(RV));
+        LHS = NodeContext->create<BinaryExprAST>(scope, BinLoc, BinOp, std::move(LV), std::move(RV));
     }
 }
 
-unique_ptr<ExprAST> Parser::ParseIfExpr(shared_ptr<Scope> scope) {
-    SourceLocation IfLoc = TheLexer->CurLoc;
+ASTPtr<ExprAST> Parser::ParseIfExpr(Scope *scope) {
+    SourceLocation IfLoc = TheLexer->getCurLoc();
 
     getNextToken();
 
-    auto IfScope = make_shared<Scope>(scope);
+    auto IfScope = NewScope(scope);
 
     auto Cond = ParseExpr(IfScope);
     if (!Cond)
@@ -308,10 +316,10 @@ unique_ptr<ExprAST> Parser::ParseIfExpr(shared_ptr<Scope> scope) {
 
     SkipColon();
 
-    return make_unique<IfExprAST>(IfScope, IfLoc, std::move(Cond), std::move(Then), std::move(Else));
+    return NodeContext->create<IfExprAST>(IfScope, IfLoc, std::move(Cond), std::move(Then), std::move(Else));
 }
 
-unique_ptr<ExprAST> Parser::ParseForExpr(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseForExpr(Scope *scope) {
     getNextToken();
 
     if (getCurTok() != tok_left_paren)
@@ -321,9 +329,11 @@ unique_ptr<ExprAST> Parser::ParseForExpr(shared_ptr<Scope> scope) {
     if (getCurTok() != tok_type_int)
         return LogError("expected int");
 
-    shared_ptr<Scope> ForScope = make_shared<Scope>(scope);
+    Scope *ForScope = NewScope(scope);
 
-    auto Var = unique_ptr<VarExprAST>(static_cast<VarExprAST *>(ParseVarExpr(scope).release()));
+    auto Var = ASTPtr<VarExprAST>(static_cast<VarExprAST *>(ParseVarExpr(scope).release()));
+    if (!Var)
+        return nullptr;
 
     SkipColon();
 
@@ -331,7 +341,7 @@ unique_ptr<ExprAST> Parser::ParseForExpr(shared_ptr<Scope> scope) {
     if (!End)
         return nullptr;
 
-    unique_ptr<ExprAST> Step;
+    ASTPtr<ExprAST> Step;
     SkipColon();
 
     if (getCurTok() == tok_integer_literal) {
@@ -350,19 +360,21 @@ unique_ptr<ExprAST> Parser::ParseForExpr(shared_ptr<Scope> scope) {
 
 
     SkipColon();
-    return make_unique<ForExprAST>(ForScope,
+    return NodeContext->create<ForExprAST>(ForScope,
                                    std::move(Var),
                                    std::move(End),
                                    std::move(Step),
                                    std::move(Body));
 }
 
-unique_ptr<ExprAST> Parser::ParseUnary(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseUnary(Scope *scope) {
     if (!isascii(getCurTok()) || // literal
         getCurTok() == tok_left_paren || // ()
         getCurTok() == tok_comma) {// ,
 
         auto LHS = ParsePrimary(scope);
+        if (!LHS)
+            return nullptr;
 
         if (getCurTok() == tok_left_square) { // '['
             getNextToken(); // eat '['
@@ -380,12 +392,14 @@ unique_ptr<ExprAST> Parser::ParseUnary(shared_ptr<Scope> scope) {
             if (getCurTok() == tok_equal) {
                 getNextToken();
                 auto Value = ParseExpr(scope);
+                if (!Value)
+                    return nullptr;
                 SkipColon();
-                auto RV = make_unique<RightValueAST>(scope, std::move(Value));
-                return make_unique<IndexerAST>(scope, std::move(LHS), std::move(Idx), std::move(RV));
+                auto RV = NodeContext->create<RightValueAST>(scope, std::move(Value));
+                return NodeContext->create<IndexerAST>(scope, std::move(LHS), std::move(Idx), std::move(RV));
             } else {
                 SkipColon();
-                return make_unique<IndexerAST>(scope, std::move(LHS), std::move(Idx));
+                return NodeContext->create<IndexerAST>(scope, std::move(LHS), std::move(Idx));
             }
         }
 
@@ -396,17 +410,17 @@ unique_ptr<ExprAST> Parser::ParseUnary(shared_ptr<Scope> scope) {
     getNextToken();
 
     if (auto Operand = ParseUnary(scope))
-        return make_unique<UnaryExprAST>(scope, Opc, std::move(Operand));
+        return NodeContext->create<UnaryExprAST>(scope, Opc, std::move(Operand));
 
     return nullptr;
 }
 
-VarType Parser::ParseType(shared_ptr<Scope> scope) {
+VarType Parser::ParseType(Scope *scope) {
     Token Tok = getCurTok();
     VarType Type = getVarType(Tok);
     if (Type.TypeID == VarTypeUnkown) {
-        if (scope->getClass(TheLexer->IdentifierStr)) {
-            Type = VarType(VarTypeObject, TheLexer->IdentifierStr);
+        if (scope->getClass(TheLexer->getSymbol())) {
+            Type = VarType(VarTypeObject, TheLexer->getIdentifier().str());
         } else {
             LogError("unkown var type");
             return Type;
@@ -422,16 +436,18 @@ VarType Parser::ParseType(shared_ptr<Scope> scope) {
     return Type;
 }
 
-unique_ptr<ExprAST> Parser::ParseVarExpr(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseVarExpr(Scope *scope) {
     VarType Type = ParseType(scope);
+    if (Type.TypeID == VarTypeUnkown)
+        return nullptr;
 
-    string Name;
+    Symbol Name;
     if (getCurTok() == tok_identifier) {
-        Name = TheLexer->IdentifierStr;
+        Name = TheLexer->getSymbol();
         getNextToken();
     }
 
-    unique_ptr<ExprAST> Init;
+    ASTPtr<ExprAST> Init;
     if (getCurTok() == tok_equal) {
         getNextToken();
 
@@ -441,24 +457,28 @@ unique_ptr<ExprAST> Parser::ParseVarExpr(shared_ptr<Scope> scope) {
     }
     SkipColon();
 
-    return make_unique<VarExprAST>(scope, Type, Name, std::move(Init));
+    return NodeContext->create<VarExprAST>(scope, Type, Name, std::move(Init));
 }
 
-unique_ptr<PrototypeAST> Parser::ParsePrototype(shared_ptr<Scope> scope, string &ClassName) {
+ASTPtr<PrototypeAST> Parser::ParsePrototype(Scope *scope, Symbol ClassName) {
+    // Prototypes outlive the bodies, calls in later items are generated against them.
+    SaveAndRestore<ASTContext *> InDecls(NodeContext, &TheASTContext);
 
-    SourceLocation FnLoc = TheLexer->CurLoc;
+    SourceLocation FnLoc = TheLexer->getCurLoc();
 //    Token Type = getCurTok();
     VarType RetType = ParseType(scope);
-    string FnName;
+    if (RetType.TypeID == VarTypeUnkown)
+        return nullptr;
+    Symbol FnName;
 
     unsigned Kind = 0;
     unsigned BinaryPrecedence = 30;
 
     switch (getCurTok()) {
         case tok_identifier:
-            FnName = TheLexer->IdentifierStr;
-            if (ClassName.length()) {
-                FnName = ClassName + "$" + FnName;
+            FnName = TheLexer->getSymbol();
+            if (ClassName.isValid()) {
+                FnName = Symbols.intern((ClassName.str() + "$" + FnName.str()).str());
             }
             Kind = 0;
             getNextToken();
@@ -467,7 +487,7 @@ unique_ptr<PrototypeAST> Parser::ParsePrototype(shared_ptr<Scope> scope, string
             getNextToken();
             if (!isascii(getCurTok()))
                 return LogErrorP("Excpeted unary operator");
-            FnName = string("unary") + (char)getCurTok();
+            FnName = getOperatorSymbol(false, (char)getCurTok());
             Kind = 1;
             getNextToken();
             break;
@@ -475,15 +495,14 @@ unique_ptr<PrototypeAST> Parser::ParsePrototype(shared_ptr<Scope> scope, string
             getNextToken();
             if (!isascii(getCurTok()))
                 return LogErrorP("Expected binary operator");
-            FnName = "binary";
-            FnName += (char)getCurTok();
+            FnName = getOperatorSymbol(true, (char)getCurTok());
             Kind = 2;
             getNextToken();
 
             if (getCurTok() == tok_integer_literal) {
-                if (TheLexer->IntegerVal < 1 || TheLexer->IntegerVal > 100)
+                if (TheLexer->getInt() < 1 || TheLexer->getInt() > 100)
                     return LogErrorP("Invalid precedence: must be 1..100");
-                BinaryPrecedence = (unsigned)TheLexer->IntegerVal;
+                BinaryPrecedence = (unsigned)TheLexer->getInt();
                 getNextToken();
             }
             break;
@@ -496,20 +515,22 @@ unique_ptr<PrototypeAST> Parser::ParsePrototype(shared_ptr<Scope> scope, string
     }
 
     if (!scope) {
-        scope = make_shared<Scope>();
+        scope = NewScope(nullptr);
     }
 
-    vector<unique_ptr<VarExprAST>> Args;
-    if (ClassName.length()) {
-        VarType Type = VarType(VarTypeObject, ClassName);
-        auto ThisArg = make_unique<VarExprAST>(scope, Type, "this", unique_ptr<ExprAST>());
+    vector<ASTPtr<VarExprAST>> Args;
+    if (ClassName.isValid()) {
+        VarType Type = VarType(VarTypeObject, ClassName.c_str());
+        auto ThisArg = NodeContext->create<VarExprAST>(scope, Type, Symbols.intern("this"), ASTPtr<ExprAST>());
         Args.push_back(std::move(ThisArg));
     }
     getNextToken();
 
     while (TheLexer->getVarType()) {
         auto ArgE = ParseVarExpr(scope);
-        auto Arg = unique_ptr<VarExprAST>(static_cast<VarExprAST *>(ArgE.release()));
+        if (!ArgE)
+            return nullptr;
+        auto Arg = ASTPtr<VarExprAST>(static_cast<VarExprAST *>(ArgE.release()));
         Args.push_back(std::move(Arg));
         if (getCurTok() == tok_comma)
             getNextToken();
@@ -526,51 +547,68 @@ unique_ptr<PrototypeAST> Parser::ParsePrototype(shared_ptr<Scope> scope, string
     if (Kind && Args.size() != Kind)
         return LogErrorP("Invalid number of operands for operator");
 
-    return make_unique<PrototypeAST>(FnLoc, RetType, FnName, std::move(Args), Kind != 0, BinaryPrecedence);
+    return NodeContext->create<PrototypeAST>(FnLoc, RetType, FnName, std::move(Args), Kind != 0, BinaryPrecedence);
 }
 
-unique_ptr<FunctionAST> Parser::ParseDefinition(shared_ptr<Scope> scope) {
-    string Empty;
-    auto Proto = ParsePrototype(scope, Empty);
+ASTPtr<FunctionAST> Parser::ParseDefinition(Scope *scope) {
+    // Lexing is on demand, so its time lands here too.
+    TimePhase Phase("parse", "Parse");
+    auto Proto = ParsePrototype(scope, Symbol());
     if (!Proto) {
         return nullptr;
     }
 
+    SaveAndRestore<ASTContext *> InBody(NodeContext, getBodyContext());
+    if (Items && Items->skipsBody(*Proto) && TheLexer->skipBracedBody())
+        return NodeContext->create<FunctionAST>(std::move(Proto), ASTPtr<ExprAST>());
     if (auto E = ParseExpr(scope))
-        return make_unique<FunctionAST>(std::move(Proto), std::move(E));
+        return NodeContext->create<FunctionAST>(std::move(Proto), std::move(E));
 
     return nullptr;
 }
 
-unique_ptr<FunctionAST> Parser::ParseMethod(shared_ptr<Scope> scope, string &ClassName) {
+ASTPtr<FunctionAST> Parser::ParseMethod(Scope *scope, Symbol ClassName) {
     auto Proto = ParsePrototype(scope, ClassName);
     if (!Proto) {
         return nullptr;
     }
 
+    SaveAndRestore<ASTContext *> InBody(NodeContext, getBodyContext());
+    if (Items && Items->skipsBody(*Proto) && TheLexer->skipBracedBody())
+        return NodeContext->create<FunctionAST>(std::move(Proto), ASTPtr<ExprAST>());
     if (auto E = ParseExpr(scope))
-        return make_unique<FunctionAST>(std::move(Proto), std::move(E));
+        return NodeContext->create<FunctionAST>(std::move(Proto), std::move(E));
 
     return nullptr;
 }
 
-unique_ptr<PrototypeAST> Parser::ParseExtern(shared_ptr<Scope> scope) {
+ASTPtr<PrototypeAST> Parser::ParseExtern(Scope *scope) {
+    TimePhase Phase("parse", "Parse");
     getNextToken();
-    string Empty;
-    return ParsePrototype(scope, Empty);
+    return ParsePrototype(scope, Symbol());
 }
 
-unique_ptr<FunctionAST> Parser::ParseTopLevelExpr(shared_ptr<Scope> scope) {
-    SourceLocation FnLoc = TheLexer->CurLoc;
+ASTPtr<FunctionAST> Parser::ParseTopLevelExpr(Scope *scope) {
+    TimePhase Phase("parse", "Parse");
+    SourceLocation FnLoc = TheLexer->getCurLoc();
+    SaveAndRestore<ASTContext *> InBody(NodeContext, getBodyContext());
     if (auto E = ParseExpr(scope)) {
         VarType RetType(VarTypeInt);
-        auto Proto = make_unique<PrototypeAST>(FnLoc, RetType, TopFuncName, vector<unique_ptr<VarExprAST>>());
-        return make_unique<FunctionAST>(std::move(Proto), std::move(E));
+        if (Interactive) {
+            LastExprName = Symbols.intern("__expr" + to_string(++NumExprs));
+            auto Proto = TheASTContext.create<PrototypeAST>(FnLoc, RetType, LastExprName, vector<ASTPtr<VarExprAST>>());
+            auto RV = NodeContext->create<RightValueAST>(scope, std::move(E));
+            auto Result = NodeContext->create<ExprResultAST>(scope, std::move(RV));
+            LastExpr = Result.get();
+            return NodeContext->create<FunctionAST>(std::move(Proto), std::move(Result));
+        }
+        auto Proto = TheASTContext.create<PrototypeAST>(FnLoc, RetType, Symbols.intern(TopFuncName), vector<ASTPtr<VarExprAST>>());
+        return NodeContext->create<FunctionAST>(std::move(Proto), std::move(E));
     }
     return nullptr;
 }
 
-unique_ptr<MemberAST> Parser::ParseMemberAST(shared_ptr<Scope> scope) {
+ASTPtr<MemberAST> Parser::ParseMemberAST(Scope *scope) {
     Token type = getCurTok();
     // TODO support all types
     if (type != tok_type_int &&
@@ -586,7 +624,7 @@ unique_ptr<MemberAST> Parser::ParseMemberAST(shared_ptr<Scope> scope) {
         return nullptr;
     }
 
-    string name = TheLexer->IdentifierStr;
+    Symbol name = TheLexer->getSymbol();
     getNextToken();
 
     if (getCurTok() != tok_colon) {
@@ -595,14 +633,15 @@ unique_ptr<MemberAST> Parser::ParseMemberAST(shared_ptr<Scope> scope) {
     }
     getNextToken();
 
-    return make_unique<MemberAST>(VarType(type), name);
+    return NodeContext->create<MemberAST>(VarType(type), name);
 }
 
-unique_ptr<ClassDeclAST> Parser::ParseClassDecl(shared_ptr<Scope> scope) {
-    SourceLocation ClsLoc = TheLexer->CurLoc;
+ASTPtr<ClassDeclAST> Parser::ParseClassDecl(Scope *scope) {
+    TimePhase Phase("parse", "Parse");
+    SourceLocation ClsLoc = TheLexer->getCurLoc();
 
     getNextToken();
-    string Name = TheLexer->IdentifierStr;
+    Symbol Name = TheLexer->getSymbol();
 
     getNextToken();
     if (getCurTok() != tok_left_bracket) {
@@ -611,34 +650,51 @@ unique_ptr<ClassDeclAST> Parser::ParseClassDecl(shared_ptr<Scope> scope) {
     }
     getNextToken();
 
-    vector<unique_ptr<MemberAST>> Members;
-    vector<unique_ptr<FunctionAST>> Methods;
+    vector<ASTPtr<MemberAST>> Members;
+    vector<ASTPtr<FunctionAST>> Methods;
+    DenseMap<Symbol, Symbol> MethodSymbols;
     while (getCurTok() != tok_right_bracket) {
-        if (TheLexer->getNextToken(2) == tok_left_paren) {
+        if (getCurTok() == tok_eof) {
+            LogError("expected '}' after class members");
+            return nullptr;
+        }
+        if (TheLexer->peekToken(2) == tok_left_paren) {
             if (auto Method = ParseMethod(scope, Name)) {
                 DLog(DLT_AST, Method->dumpJSON());
+                Symbol Mangled = Method->getProto().getSymbol();
+                StringRef MethodName = Mangled.str();
+                if (MethodName.consume_front(Name.str()) && MethodName.consume_front("$"))
+                    MethodSymbols[Symbols.intern(MethodName)] = Mangled;
                 Methods.push_back(std::move(Method));
             } else {
                 LogError("Parse Method failed");
+                return nullptr;
             }
         } else {
             auto Member = ParseMemberAST(scope);
+            if (!Member)
+                return nullptr;
             Members.push_back(std::move(Member));
         }
     }
 
     getNextToken();
-    return make_unique<ClassDeclAST>(scope, ClsLoc, Name, std::move(Members), std::move(Methods));
+    return NodeContext->create<ClassDeclAST>(scope, ClsLoc, Name, std::move(Members), std::move(Methods),
+                                              std::move(MethodSymbols));
 }
 
-unique_ptr<ExprAST> Parser::ParseNew(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseNew(Scope *scope) {
     getNextToken(); // eat "new"
     VarType Type = ParseType(scope);
+    if (Type.TypeID == VarTypeUnkown)
+        return nullptr;
 
-    unique_ptr<ExprAST> Size = make_unique<IntegerLiteralAST>(scope, 1);
+    ASTPtr<ExprAST> Size = NodeContext->create<IntegerLiteralAST>(scope, 1);
     if (getCurTok() == tok_left_paren) {
         getNextToken();
         Size = ParseExpr(scope);
+        if (!Size)
+            return nullptr;
 
         if (getCurTok() != tok_right_paren) {
             return LogError("expected ')' after new type");
@@ -647,39 +703,45 @@ unique_ptr<ExprAST> Parser::ParseNew(shared_ptr<Scope> scope) {
 
         SkipColon();
     }
-    return make_unique<NewAST>(scope, Type, std::move(Size));
+    return NodeContext->create<NewAST>(scope, Type, std::move(Size));
 }
 
-unique_ptr<ExprAST> Parser::ParseDelete(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseDelete(Scope *scope) {
     getNextToken();
 
     if (getCurTok() != tok_identifier)
         return LogError("expected variable");
 
-    auto LitLoc = TheLexer->CurLoc;
-    auto VarName = TheLexer->getIdentifier();
+    auto LitLoc = TheLexer->getCurLoc();
+    Symbol VarName = TheLexer->getSymbol();
     getNextToken();
     SkipColon();
-    auto Var = make_unique<VariableExprAST>(scope, LitLoc, VarName);
-    auto RVar = make_unique<RightValueAST>(scope, std::move(Var));
-    return make_unique<DeleteAST>(scope, std::move(RVar));
+    auto Var = NodeContext->create<VariableExprAST>(scope, LitLoc, VarName);
+    auto RVar = NodeContext->create<RightValueAST>(scope, std::move(Var));
+    return NodeContext->create<DeleteAST>(scope, std::move(RVar));
 }
 
-unique_ptr<ExprAST> Parser::ParseReturn(shared_ptr<Scope> scope) {
+ASTPtr<ExprAST> Parser::ParseReturn(Scope *scope) {
     getNextToken();
     auto Var = ParseExpr(scope);
+    if (!Var)
+        return nullptr;
     SkipColon();
-    auto RV = make_unique<RightValueAST>(scope, std::move(Var));
-    return make_unique<ReturnAST>(scope, std::move(RV));
+    auto RV = NodeContext->create<RightValueAST>(scope, std::move(Var));
+    return NodeContext->create<ReturnAST>(scope, std::move(RV));
 }
 
 void Parser::InitializeModuleAndPassManager() {
-    TheModule = make_unique<Module>(Filename, LLContext);
+    TheModule = make_unique<Module>(Filename, getContext());
 
     TheModule->addModuleFlag(Module::Warning, "Debug Info Version", DEBUG_METADATA_VERSION);
     if (Triple(sys::getProcessTriple()).isOSDarwin())
         TheModule->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 2);
 
+    // -O0 keeps the alloca-heavy IR as it is.
+    if (OptLevel == 0)
+        return;
+
     // Create a new pass manager attached to it.
     TheFPM = make_unique<legacy::FunctionPassManager>(TheModule.get());
 
@@ -697,49 +759,81 @@ void Parser::InitializeModuleAndPassManager() {
     TheFPM->doInitialization();
 }
 
-void Parser::HandleDefinition(shared_ptr<Scope> scope) {
+void Parser::HandleDefinition(Scope *scope) {
+    if (Items)
+        Items->beginItem();
     if (getCurTok() == tok_class) {
         if (auto ClsDecl = ParseClassDecl(scope)) {
             DLog(DLT_AST, ClsDecl->dumpJSON());
-            auto C = ClsDecl.get();
-            scope->appendClass(ClsDecl->getName(), std::move(ClsDecl));
-            C->codegen();
+            scope->appendClass(ClsDecl->getName(), ClsDecl.get());
+            if (Tiered)
+                Tiered->addClass(ClsDecl.get());
+            else if (Items)
+                Items->addClass(ClsDecl.get());
+            else
+                ClsDecl->codegen();
         } else {
             LogError("Parse ClassDecl failed");
+            SkipItem();
         }
-    } else if (TheLexer->getNextToken(2) == tok_left_paren) {
+    } else if (TheLexer->peekToken(2) == tok_left_paren) {
         if (auto FnAST = ParseDefinition(scope)) {
             DLog(DLT_AST, FnAST->dumpJSON());
-            FnAST->codegen();
+            if (Tiered)
+                HandleTiered(FnAST.get());
+            else if (Items)
+                Items->addFunction(FnAST.get());
+            else
+                FnAST->codegen();
         } else {
             LogError("Parse Function failed");
+            SkipItem();
         }
     } else {
         HandleTopLevelExpression(scope);
     }
 }
 
-void Parser::HandleExtern(shared_ptr<Scope> scope) {
+void Parser::HandleExtern(Scope *scope) {
     if (auto ProtoAST = ParseExtern(scope)) {
         DLog(DLT_AST, ProtoAST->dumpJSON());
+        if (Items)
+            Items->addExtern(*ProtoAST);
         if (auto *FnIR = ProtoAST->codegen()) {
-            FunctionProtos[ProtoAST->getName()] = std::move(ProtoAST);
+            FunctionProtos[ProtoAST->getSymbol()] = std::move(ProtoAST);
         }
     } else {
         LogError("parse extern failed");
+        SkipItem();
     }
 }
 
-void Parser::HandleTopLevelExpression(shared_ptr<Scope> scope) {
+void Parser::HandleTopLevelExpression(Scope *scope) {
+    if (Items)
+        Items->beginItem();
     if (auto FnAST = ParseTopLevelExpr(scope)) {
         DLog(DLT_AST, FnAST->dumpJSON());
-        FnAST->codegen();
+        if (Tiered)
+            HandleTiered(FnAST.get());
+        else if (Items)
+            Items->addFunction(FnAST.get());
+        else
+            FnAST->codegen();
     } else {
         LogError("parse top level expr failed");
+        SkipItem();
     }
 }
 
-AllocaInst * Parser::CreateEntryBlockAlloca(Function *F, Type *T, const string &VarName) {
+void Parser::HandleTiered(FunctionAST *FnAST) {
+    // Codegen would set the precedence, later expressions are parsed with it.
+    auto &P = FnAST->getProto();
+    if (P.isBinaryOp())
+        SetBinOpPrecedence(P.getOperatorName(), P.getBinaryPrecedence());
+    Tiered->addFunction(FnAST);
+}
+
+AllocaInst * Parser::CreateEntryBlockAlloca(Function *F, Type *T, StringRef VarName) {
     IRBuilder<> TmpBlock(&F->getEntryBlock(), F->getEntryBlock().begin());
     return TmpBlock.CreateAlloca(T, 0, VarName);
 }
@@ -748,9 +842,9 @@ AllocaInst * Parser::CreateEntryBlockAlloca(Function *F, VarExprAST *Var) {
     return Parser::CreateEntryBlockAlloca(F, Var->getIRType(F->getContext()), Var->getName());
 }
 
-Function * Parser::getFunction(std::string Name) {
+Function * Parser::getFunction(Symbol Name) {
     // First, see if the function has already been added to the current module.
-    if (auto *F = TheModule->getFunction(Name))
+    if (auto *F = TheModule->getFunction(Name.str()))
         return F;
 
     // If not, check whether we can codegen the declaration from some existing
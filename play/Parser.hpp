@@ -10,6 +10,7 @@
 #define Parser_hpp
 
 #include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/Passes.h"
@@ -24,6 +25,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Support/TargetRegistry.h"
@@ -36,6 +38,10 @@
 #include <iostream>
 
 #include "Lexer.hpp"
+#include "ASTContext.hpp"
+#include "Symbol.hpp"
+#include "Timing.hpp"
+#include "Interpreter.hpp"
 
 using namespace std;
 using namespace llvm;
@@ -176,54 +182,64 @@ public:
 
 class ExprAST;
 class ClassDeclAST;
+class FlatAST;
 
-static unsigned gId = 0;
+/// intern - Maps a name to its symbol in the current unit's table.
+inline Symbol intern(StringRef Name);
+
+/// Scope - One lexical block. Scopes are arena allocated by the parser and
+/// never freed on their own, so children keep a plain pointer to the parent.
+/// Each table is an open-addressing DenseMap keyed by interned symbols.
 class Scope {
-    map<string, VarType> VarTypes;
-    map<string, Value *> VarVals;
-    map<string, unique_ptr<ClassDeclAST>> Classes;
-    map<string, StructType *> ClassTypes;
+    DenseMap<Symbol, VarType> VarTypes;
+    DenseMap<Symbol, Value *> VarVals;
+    DenseMap<Symbol, ClassDeclAST *> Classes;
+    DenseMap<Symbol, StructType *> ClassTypes;
 
 public:
-    shared_ptr<Scope> Parent;
+    Scope *Parent;
     unsigned Id;
 
-    Scope() { Id = ++ gId; }
-    Scope(shared_ptr<Scope> parent): Parent(parent) { Id = ++ gId; }
+    Scope(Scope *parent, unsigned id): Parent(parent), Id(id) {}
 
-    void setValType(string Name, VarType Type) {
+    void setValType(Symbol Name, VarType Type) {
         VarTypes[Name] = Type;
     }
-    const VarType getValType(const string &name) {
-        if (VarTypes[name].TypeID) return VarTypes[name];
-        if (Parent) return Parent->getValType(name);
+    const VarType getValType(Symbol Name) const {
+        for (auto S = this; S; S = S->Parent) {
+            auto I = S->VarTypes.find(Name);
+            if (I != S->VarTypes.end() && I->second.TypeID) return I->second;
+        }
         return VarType(VarTypeUnkown);
     }
-    void setVal(string var, Value *val) {
-        if (var=="tall")
-            cout << "setVal " << var << " => " << val->getType()->getTypeID() << endl;
-
-        VarVals[var] = val;
+    void setVal(Symbol Name, Value *Val) {
+        VarVals[Name] = Val;
     }
-    Value *getVal(const string name) {
-        return VarVals[name] ?: (Parent ? Parent->getVal(name) : nullptr);
+    Value *getVal(Symbol Name) const {
+        for (auto S = this; S; S = S->Parent) {
+            auto I = S->VarVals.find(Name);
+            if (I != S->VarVals.end() && I->second) return I->second;
+        }
+        return nullptr;
     }
-    void appendClass(string name, unique_ptr<ClassDeclAST> C) {
-        Classes[name] = std::move(C);
+    void appendClass(Symbol Name, ClassDeclAST *C) {
+        Classes[Name] = C;
     }
-    ClassDeclAST *getClass(const string &name) {
-        if (Classes[name]) return Classes[name].get();
-        if (Parent) return Parent->getClass(name);
+    ClassDeclAST *getClass(Symbol Name) const {
+        for (auto S = this; S; S = S->Parent) {
+            auto I = S->Classes.find(Name);
+            if (I != S->Classes.end() && I->second) return I->second;
+        }
         return nullptr;
     }
-    void setClassType(string ClsName, StructType * ClsType) {
+    void setClassType(Symbol ClsName, StructType *ClsType) {
         ClassTypes[ClsName] = ClsType;
     }
-    StructType * getClassType(const string ClsName) {
-        if (ClassTypes[ClsName])
-            return ClassTypes[ClsName];
-        if (Parent)
-            return Parent->getClassType(ClsName);
+    StructType *getClassType(Symbol ClsName) const {
+        for (auto S = this; S; S = S->Parent) {
+            auto I = S->ClassTypes.find(ClsName);
+            if (I != S->ClassTypes.end() && I->second) return I->second;
+        }
         return nullptr;
     }
 };
@@ -232,129 +248,126 @@ class ExprAST {
     SourceLocation Loc;
 
 protected:
-    shared_ptr<Scope> scope;
+    Scope *scope;
 
 public:
-    ExprAST(shared_ptr<Scope> scope);
-    ExprAST(shared_ptr<Scope> scope, SourceLocation Loc) : scope(scope), Loc(Loc) {}
+    ExprAST(Scope *scope);
+    ExprAST(Scope *scope, SourceLocation Loc) : scope(scope), Loc(Loc) {}
     virtual ~ExprAST() {}
     virtual Value *codegen() = 0;
+    /// interpret - Runs this node in tier 0, for the nodes FlatInterpretable
+    /// accepts. A function with any other node is compiled before its first call.
+    virtual InterpValue interpret(InterpFrame &Frame) {
+        assert(false && "node can't be interpreted");
+        return InterpValue();
+    }
+    virtual void interpretAssign(InterpFrame &Frame, InterpValue V) {
+        assert(false && "node can't be assigned to");
+    }
     int getLine() const { return Loc.Line; };
     int getCol() const { return Loc.Col; }
     virtual raw_ostream &dump(raw_ostream &out, int ind) {
         return out << ":" << getLine() << ":" << getCol() << "\n";
     }
-    shared_ptr<Scope> getScope() const { return scope; }
-    void setScope(shared_ptr<Scope> newScope) { scope = newScope; }
+    Scope *getScope() const { return scope; }
+    void setScope(Scope *newScope) { scope = newScope; }
 
-    virtual string dumpJSON() = 0;
-
-    static string listDumpJSON(vector<unique_ptr<ExprAST>> &Exprs) {
-        string JSON = "[";
-        for (auto E = Exprs.begin(); E != Exprs.end(); E ++) {
-            JSON += (*E)->dumpJSON();
-            if (E != Exprs.end() - 1) {
-                JSON += ",";
-            }
-        }
-        JSON += "]";
-        return JSON;
-    }
+    /// flatten - Appends the node and then its children to F, returns the
+    /// node's index. Defined in FlatAST.cpp.
+    virtual unsigned flatten(FlatAST &F) const = 0;
+    /// dumpJSON - The expression as JSON, written from its FlatAST.
+    string dumpJSON() const;
 };
 
-static unique_ptr<ExprAST> ParseExpr(shared_ptr<Scope> scope);
+static ASTPtr<ExprAST> ParseExpr(Scope *scope);
 
 class VarExprAST : public ExprAST {
-    string Name;
+    Symbol Name;
     VarType Type;
-    unique_ptr<ExprAST> Init;
+    ASTPtr<ExprAST> Init;
 
 
-    static llvm::Type *getIRType(LLVMContext &context, shared_ptr<Scope> scope, VarType &VT) {
+    static llvm::Type *getIRType(LLVMContext &context, Scope *scope, VarType &VT) {
         switch (VT.TypeID) {
             case VarTypeVoid: return Type::getVoidTy(context);
             case VarTypeBool: return Type::getInt1Ty(context);
             case VarTypeInt: return Type::getInt64Ty(context);
             case VarTypeFloat: return Type::getDoubleTy(context);
-            case VarTypeObject: return scope->getClassType(VT.ClassName)->getPointerTo();
+            case VarTypeObject: return scope->getClassType(intern(VT.ClassName))->getPointerTo();
             case VarTypeStar: return getIRType(context, scope, VT.pointerElement())->getPointerTo();
             default: return nullptr;
         }
     }
 
 public:
-    VarExprAST(shared_ptr<Scope> scope, VarType type, string name, unique_ptr<ExprAST> init)
+    VarExprAST(Scope *scope, VarType type, Symbol name, ASTPtr<ExprAST> init)
         : ExprAST(scope), Type(type), Name(name), Init(std::move(init)) {
             scope->setValType(name, type);
         }
 
     Value *codegen() override;
-    const string &getName() const { return Name; }
+    InterpValue interpret(InterpFrame &Frame) override;
+    StringRef getName() const { return Name.str(); }
+    Symbol getSymbol() const { return Name; }
     const VarType &getType() const { return Type; }
     llvm::Type *getIRType(LLVMContext &Context) {
         return VarExprAST::getIRType(Context, scope, Type);
     }
     ExprAST * getInit() const { return Init.get(); }
 
-    string dumpJSON() override {
-        return FormatString("{`type`: `Var`, `Name`: `%s`, `Type`: %d}", Name.c_str(), (int)Type.TypeID);
-    }
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class CompoundExprAST : public ExprAST {
-    vector<unique_ptr<ExprAST>> Exprs;
+    vector<ASTPtr<ExprAST>> Exprs;
 
 public:
-    CompoundExprAST(shared_ptr<Scope> scope, vector<unique_ptr<ExprAST>> exprs): ExprAST(scope), Exprs(std::move(exprs)) {}
+    CompoundExprAST(Scope *scope, vector<ASTPtr<ExprAST>> exprs): ExprAST(scope), Exprs(std::move(exprs)) {}
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `Compound`, `Exprs`: %s]}", ExprAST::listDumpJSON(Exprs).c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class IntegerLiteralAST : public ExprAST {
     long Val;
 
 public:
-    IntegerLiteralAST(shared_ptr<Scope> scope, long val): ExprAST(scope), Val(val) {}
+    IntegerLiteralAST(Scope *scope, long val): ExprAST(scope), Val(val) {}
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `IntegerLiteral`, `Val`: `%s`}", to_string(Val).c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class FloatLiteralAST : public ExprAST {
     double Val;
 
 public:
-    FloatLiteralAST(shared_ptr<Scope> scope, double val): ExprAST(scope), Val(val) {}
+    FloatLiteralAST(Scope *scope, double val): ExprAST(scope), Val(val) {}
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `FloatLiteral`, `Val`: `%s`}", to_string(Val).c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class VariableExprAST : public ExprAST {
-    string Name;
+    Symbol Name;
 
 public:
-    VariableExprAST(shared_ptr<Scope> scope, SourceLocation loc, const string &name) : ExprAST(scope, loc), Name(name) {}
+    VariableExprAST(Scope *scope, SourceLocation loc, Symbol name) : ExprAST(scope, loc), Name(name) {}
     Value *codegen() override;
-    string &getName() { return Name; }
-    string dumpJSON() override {
-        return FormatString("{`type`: `Variable`, `Name`: `%s`}", Name.c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    void interpretAssign(InterpFrame &Frame, InterpValue V) override;
+    StringRef getName() const { return Name.str(); }
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class RightValueAST : public ExprAST {
-    unique_ptr<ExprAST> Expr;
+    ASTPtr<ExprAST> Expr;
 
 public:
-    RightValueAST(shared_ptr<Scope> scope, unique_ptr<ExprAST> expr) : ExprAST(scope), Expr(std::move(expr)) {}
+    RightValueAST(Scope *scope, ASTPtr<ExprAST> expr) : ExprAST(scope), Expr(std::move(expr)) {}
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `RightValue`, `Expr`: %s}", Expr->dumpJSON().c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
     ExprAST *getExpr() {
         return Expr.get();
     }
@@ -362,120 +375,108 @@ public:
 
 class BinaryExprAST : public ExprAST {
     char Op;
-    unique_ptr<ExprAST> LHS, RHS;
+    ASTPtr<ExprAST> LHS, RHS;
 
 public:
-    BinaryExprAST(shared_ptr<Scope> scope,
+    BinaryExprAST(Scope *scope,
                   SourceLocation loc,
                   char op,
-                  unique_ptr<ExprAST> lhs,
-                  unique_ptr<ExprAST> rhs)
+                  ASTPtr<ExprAST> lhs,
+                  ASTPtr<ExprAST> rhs)
         : ExprAST(scope, loc), Op(op), LHS(std::move(lhs)), RHS(std::move(rhs)) {}
     Value *codegen() override;
-    string dumpJSON() override {
-        string lhs = LHS->dumpJSON();
-        string rhs = RHS->dumpJSON();
-        return FormatString("{`type`: `Binary`, `Operator`: `%c`, `LHS`: %s, `RHS`: %s}", Op, LHS->dumpJSON().c_str(), RHS->dumpJSON().c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class CallExprAST : public ExprAST {
-    string Callee;
-    vector<unique_ptr<ExprAST>> Args;
+    Symbol Callee;
+    vector<ASTPtr<ExprAST>> Args;
 
 public:
-    CallExprAST(shared_ptr<Scope> scope,
+    CallExprAST(Scope *scope,
                 SourceLocation loc,
-                const string &callee,
-                vector<unique_ptr<ExprAST>> args)
+                Symbol callee,
+                vector<ASTPtr<ExprAST>> args)
         : ExprAST(scope, loc), Callee(callee), Args(std::move(args)) {}
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `Call`, `Callee`: `%s`, `Args`: %s}", Callee.c_str(), ExprAST::listDumpJSON(Args).c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class MethodCallAST : public ExprAST {
     // TODO
     // SourceLocation Loc;
 
-    unique_ptr<ExprAST> Var;
-    string Callee;
-    vector<unique_ptr<ExprAST>> Args;
+    ASTPtr<ExprAST> Var;
+    Symbol Callee;
+    vector<ASTPtr<ExprAST>> Args;
 
 public:
-    MethodCallAST(shared_ptr<Scope> scope,
+    MethodCallAST(Scope *scope,
 //                  SourceLocation loc,
-                  unique_ptr<ExprAST> var,
-                  const string &callee,
-                  vector<unique_ptr<ExprAST>> args)
+                  ASTPtr<ExprAST> var,
+                  Symbol callee,
+                  vector<ASTPtr<ExprAST>> args)
         : ExprAST(scope), Var(std::move(var)), Callee(callee), Args(std::move(args)) {}
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `MethodCall`, `Var`: %s, `Callee`: `%s`, `Args`: %s}", Var->dumpJSON().c_str(), Callee.c_str(), ExprAST::listDumpJSON(Args).c_str());
-    }
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class MemberAccessAST : public ExprAST {
     // TODO
     // SourceLocation Loc;
 
-    unique_ptr<ExprAST> Var;
-    string Member;
-    unique_ptr<ExprAST> RHS;
+    ASTPtr<ExprAST> Var;
+    Symbol Member;
+    ASTPtr<ExprAST> RHS;
 
 public:
-    MemberAccessAST(shared_ptr<Scope> scope, unique_ptr<ExprAST> var, string member)
+    MemberAccessAST(Scope *scope, ASTPtr<ExprAST> var, Symbol member)
         : ExprAST(scope), Var(std::move(var)), Member(member) {}
-    MemberAccessAST(shared_ptr<Scope> scope, unique_ptr<ExprAST> var, string member, unique_ptr<ExprAST> RHS)
+    MemberAccessAST(Scope *scope, ASTPtr<ExprAST> var, Symbol member, ASTPtr<ExprAST> RHS)
         : ExprAST(scope), Var(std::move(var)), Member(member), RHS(std::move(RHS)) {}
 
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `MemberAccess`, `Var`: %s, `Member`: `%s`, `RHS`: %s}",
-                            Var->dumpJSON().c_str(), Member.c_str(), RHS ? RHS->dumpJSON().c_str() : "null");
-    }
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class IndexerAST : public ExprAST {
 
-    unique_ptr<ExprAST> Var;
-    unique_ptr<ExprAST> Index;
-    unique_ptr<ExprAST> RHS;
+    ASTPtr<ExprAST> Var;
+    ASTPtr<ExprAST> Index;
+    ASTPtr<ExprAST> RHS;
 
 public:
-    IndexerAST(shared_ptr<Scope> scope,
-               unique_ptr<ExprAST> var,
-               unique_ptr<ExprAST> index)
+    IndexerAST(Scope *scope,
+               ASTPtr<ExprAST> var,
+               ASTPtr<ExprAST> index)
         : ExprAST(scope), Var(std::move(var)), Index(std::move(index)) {}
 
-    IndexerAST(shared_ptr<Scope> scope,
-               unique_ptr<ExprAST> var,
-               unique_ptr<ExprAST> index,
-               unique_ptr<ExprAST> RHS)
+    IndexerAST(Scope *scope,
+               ASTPtr<ExprAST> var,
+               ASTPtr<ExprAST> index,
+               ASTPtr<ExprAST> RHS)
         : ExprAST(scope), Var(std::move(var)), Index(std::move(index)), RHS(std::move(RHS)) {}
 
     Value *codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `IndexSubscribe`, `Var`: %s, `Index`: %s, `RHS`: %s}",
-                            Var->dumpJSON().c_str(), Index->dumpJSON().c_str(), RHS ? RHS->dumpJSON().c_str() : "null");
-    }
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class PrototypeAST {
     SourceLocation Loc;
 //    Token RetType;
     VarType RetType;
-    string Name;
-    vector<unique_ptr<VarExprAST>> Args;
+    Symbol Name;
+    vector<ASTPtr<VarExprAST>> Args;
     bool IsOperator;
     unsigned Precedence;
 
 public:
     PrototypeAST(SourceLocation loc,
                  VarType &type,
-                 string &name,
-                 vector<unique_ptr<VarExprAST>> args,
+                 Symbol name,
+                 vector<ASTPtr<VarExprAST>> args,
                  bool isOperator = false,
                  unsigned precedence = 0)
         :
@@ -488,13 +489,18 @@ public:
 
     Function *codegen();
 
-    const string &getName() const { return Name; }
+    StringRef getName() const { return Name.str(); }
+    Symbol getSymbol() const { return Name; }
+    Symbol getArgSymbol(size_t i) const { return Args[i]->getSymbol(); }
+    size_t getNumArgs() const { return Args.size(); }
+    const VarType &getArgType(size_t i) const { return Args[i]->getType(); }
+    const VarType &getRetType() const { return RetType; }
     bool isUnaryOp() const { return IsOperator && Args.size() == 1; }
     bool isBinaryOp() const { return IsOperator && Args.size() == 2; }
 
     char getOperatorName() const {
         assert(isUnaryOp() || isBinaryOp());
-        return Name[Name.size()-1];
+        return Name.str().back();
     }
 
     unsigned getBinaryPrecedence() const { return Precedence; }
@@ -515,47 +521,49 @@ public:
 
 /// FunctionAST - This class represents a function definition itself.
 class FunctionAST {
-    std::unique_ptr<PrototypeAST> Proto;
-    std::unique_ptr<ExprAST> Body;
+    ASTPtr<PrototypeAST> Proto;
+    ASTPtr<ExprAST> Body;
 
 public:
-  FunctionAST(std::unique_ptr<PrototypeAST> Proto,
-              std::unique_ptr<ExprAST> Body)
+  FunctionAST(ASTPtr<PrototypeAST> Proto,
+              ASTPtr<ExprAST> Body)
       : Proto(std::move(Proto)), Body(std::move(Body)) {}
 
     const PrototypeAST& getProto() const;
-    const std::string& getName() const;
+    StringRef getName() const;
+    ExprAST *getBody() const { return Body.get(); }
     llvm::Function *codegen();
+    /// declare - Makes the prototype known to later code without generating the body.
+    void declare();
     std::string dumpJSON();
 };
 
 class IfExprAST : public ExprAST {
-    unique_ptr<ExprAST> Cond, Then, Else;
+    ASTPtr<ExprAST> Cond, Then, Else;
 
 public:
-    IfExprAST(shared_ptr<Scope> scope,
+    IfExprAST(Scope *scope,
               SourceLocation loc,
-              unique_ptr<ExprAST> cond,
-              unique_ptr<ExprAST> then,
-              unique_ptr<ExprAST> elseE)
+              ASTPtr<ExprAST> cond,
+              ASTPtr<ExprAST> then,
+              ASTPtr<ExprAST> elseE)
         : ExprAST(scope, loc), Cond(std::move(cond)), Then(std::move(then)), Else(std::move(elseE)) {}
 
     Value * codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `If`, `Cond`: %s, `Then`: %s, `Else`: %s}", Cond->dumpJSON().c_str(), Then->dumpJSON().c_str(), Else->dumpJSON().c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class ForExprAST : public ExprAST {
-    unique_ptr<VarExprAST> Var;
-    unique_ptr<ExprAST> Start, End, Step, Body;
+    ASTPtr<VarExprAST> Var;
+    ASTPtr<ExprAST> Start, End, Step, Body;
 
 public:
-    ForExprAST(shared_ptr<Scope> scope,
-               unique_ptr<VarExprAST> var,
-               unique_ptr<ExprAST> end,
-               unique_ptr<ExprAST> step,
-               unique_ptr<ExprAST> body):
+    ForExprAST(Scope *scope,
+               ASTPtr<VarExprAST> var,
+               ASTPtr<ExprAST> end,
+               ASTPtr<ExprAST> step,
+               ASTPtr<ExprAST> body):
         ExprAST(scope),
         Var(std::move(var)),
         End(std::move(end)),
@@ -563,72 +571,85 @@ public:
         Body(std::move(body)) {}
 
     Value * codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `For`, `Var`: %s, `End`: %s, `Step`: %s, `Body`: %s}", Var->dumpJSON().c_str(), End->dumpJSON().c_str(), Step->dumpJSON().c_str(), Body->dumpJSON().c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class UnaryExprAST : public ExprAST {
     char Opcode;
-    unique_ptr<ExprAST> Operand;
+    ASTPtr<ExprAST> Operand;
 
 public:
-    UnaryExprAST(shared_ptr<Scope> scope, char opcode, unique_ptr<ExprAST> operand)
+    UnaryExprAST(Scope *scope, char opcode, ASTPtr<ExprAST> operand)
         : ExprAST(scope), Opcode(opcode), Operand(std::move(operand)) {}
 
     Value * codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `Unary`, `Operand`: `%s`}", Operand->dumpJSON().c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class NewAST : public ExprAST {
     VarType Type;
-    unique_ptr<ExprAST> Size;
+    ASTPtr<ExprAST> Size;
 
 public:
-    NewAST(shared_ptr<Scope> scope, VarType type, unique_ptr<ExprAST> size)
+    NewAST(Scope *scope, VarType type, ASTPtr<ExprAST> size)
         : ExprAST(scope), Type(type), Size(std::move(size)) {}
 
     Value * codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `New`, `Type`: `%s`, `Size`: %s}", Type.dumpJSON().c_str(), Size->dumpJSON().c_str());
-    }
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class DeleteAST : public ExprAST {
-    unique_ptr<ExprAST> Var;
+    ASTPtr<ExprAST> Var;
 
 public:
-    DeleteAST(shared_ptr<Scope> scope, unique_ptr<ExprAST> var)
+    DeleteAST(Scope *scope, ASTPtr<ExprAST> var)
         : ExprAST(scope), Var(std::move(var)) {}
 
     Value * codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `Delete`, `Var`: %s}", Var->dumpJSON().c_str());
-    }
+    unsigned flatten(FlatAST &F) const override;
 };
 
 class ReturnAST : public ExprAST {
-    unique_ptr<ExprAST> Var;
+    ASTPtr<ExprAST> Var;
 
 public:
-    ReturnAST(shared_ptr<Scope> scope) : ExprAST(scope) {}
-    ReturnAST(shared_ptr<Scope> scope, unique_ptr<ExprAST> var)
+    ReturnAST(Scope *scope) : ExprAST(scope) {}
+    ReturnAST(Scope *scope, ASTPtr<ExprAST> var)
         : ExprAST(scope), Var(std::move(var)) {}
 
     Value * codegen() override;
-    string dumpJSON() override {
-        return FormatString("{`type`: `Return`, `Var`: %s}", Var->dumpJSON().c_str());
-    }
+    InterpValue interpret(InterpFrame &Frame) override;
+    unsigned flatten(FlatAST &F) const override;
+};
+
+/// ExprResultAST - Body of an interactive top level expression. Returns the
+/// value from the function as an i64, a double by its bits.
+class ExprResultAST : public ExprAST {
+    ASTPtr<ExprAST> Expr;
+    Type *ResultType = nullptr;
+
+public:
+    ExprResultAST(Scope *scope, ASTPtr<ExprAST> expr)
+        : ExprAST(scope), Expr(std::move(expr)) {}
+
+    Value * codegen() override;
+    unsigned flatten(FlatAST &F) const override;
+    /// createResult - Returns V, or a return statement's value, widened to
+    /// the i64 of the function.
+    Value *createResult(Value *V);
+    /// getResultType - Type of the value before it was widened, null if the
+    /// expression has none. Known once codegen has run.
+    Type *getResultType() const { return ResultType; }
 };
 
 class MemberAST {
 public:
     VarType VType;
-    string Name;
+    Symbol Name;
 
-    MemberAST(VarType type, string &name) : VType(type), Name(name) {}
+    MemberAST(VarType type, Symbol name) : VType(type), Name(name) {}
 
     string dumpJSON()  {
         return FormatString("{`type`: `Member`, `Type`: %s, `Name`: `%s`}", VType.dumpJSON().c_str(), Name.c_str());
@@ -637,24 +658,36 @@ public:
 
 class ClassDeclAST {
     SourceLocation Loc;
-    shared_ptr<Scope> scope;
-    string Name;
-    vector<unique_ptr<MemberAST>> Members;
-    vector<unique_ptr<FunctionAST>> Methods;
+    Scope *scope;
+    Symbol Name;
+    vector<ASTPtr<MemberAST>> Members;
+    vector<ASTPtr<FunctionAST>> Methods;
+    // Method name to mangled function name, e.g. "get" to "Point$get".
+    DenseMap<Symbol, Symbol> MethodSymbols;
+
+    StructType *createType();
 
 public:
-  ClassDeclAST(shared_ptr<Scope> scope,
+  ClassDeclAST(Scope *scope,
                SourceLocation loc,
-               string name,
-               vector<unique_ptr<MemberAST>> members,
-               vector<unique_ptr<FunctionAST>> methods)
+               Symbol name,
+               vector<ASTPtr<MemberAST>> members,
+               vector<ASTPtr<FunctionAST>> methods,
+               DenseMap<Symbol, Symbol> methodSymbols)
       : Loc(loc), scope(scope), Name(name),
-        Members(std::move(members)), Methods(std::move(methods)) {}
+        Members(std::move(members)), Methods(std::move(methods)),
+        MethodSymbols(std::move(methodSymbols)) {}
 
-    string& getName() { return Name; }
+    Symbol getName() const { return Name; }
     const size_t getMemberSize() const { return Members.size(); }
     const MemberAST *getMember(size_t i) const { return Members[i].get(); }
-    const unsigned indexOfMember(const string &MemName) const {
+    size_t getNumMethods() const { return Methods.size(); }
+    const FunctionAST *getMethod(size_t i) const { return Methods[i].get(); }
+    Symbol getMethodSymbol(Symbol MethodName) const {
+        auto I = MethodSymbols.find(MethodName);
+        return I == MethodSymbols.end() ? Symbol() : I->second;
+    }
+    const unsigned indexOfMember(Symbol MemName) const {
         unsigned idx = 0;
         for (auto E = Members.begin(); E != Members.end(); E ++, idx ++) {
             if ((*E)->Name == MemName) break;
@@ -669,18 +702,27 @@ public:
         return bytes;
     }
     StructType *codegen();
+    /// declare - The type and the method prototypes, no method bodies.
+    StructType *declare();
     string dumpJSON()  {
         return FormatString("{`Type`: `ClassDecl`, `Name`: `%s`}", Name.c_str());
     }
 };
 
-static unique_ptr<ExprAST> LogError(std::string Str) {
+/// NumErrors - Errors logged on this thread. A compile compares it before
+/// and after, so one bad source fails alone and the process goes on.
+inline unsigned &NumErrors() {
+    static thread_local unsigned Count = 0;
+    return Count;
+}
+
+static ASTPtr<ExprAST> LogError(std::string Str) {
     cerr << "LogError: " << Str << endl;
-    assert(false && Str.c_str());
+    NumErrors()++;
     return nullptr;
 }
 
-static unique_ptr<PrototypeAST> LogErrorP(std::string Str) {
+static ASTPtr<PrototypeAST> LogErrorP(std::string Str) {
     LogError(Str);
     return nullptr;
 }
@@ -690,19 +732,60 @@ static Value *LogErrorV(std::string Str) {
     return nullptr;
 }
 
+/// ItemBuilder - Generates the top level items in place of the parser, which
+/// hands each one over once it is parsed. Any item it doesn't generate it
+/// must still declare, later items are parsed and generated against it.
+class ItemBuilder {
+public:
+    virtual ~ItemBuilder() {}
+    /// beginItem - The next token starts a function, class or expression.
+    virtual void beginItem() {}
+    /// addToken - Every token the parser consumes.
+    virtual void addToken(const TokenInfo &Tok) {}
+    /// addExtern - Externs are still generated by the parser.
+    virtual void addExtern(const PrototypeAST &P) {}
+    /// skipsBody - The function or method P is only declared, its body
+    /// needn't be parsed.
+    virtual bool skipsBody(const PrototypeAST &P) { return false; }
+    virtual void addFunction(FunctionAST *F) = 0;
+    virtual void addClass(ClassDeclAST *C) = 0;
+};
+
 class Parser {
-    LLVMContext LLContext;
+    // Declared first so the nodes outlive every pointer to them below.
+    ASTContext TheASTContext;
+    // Function bodies when they are streamed, dropped after each item by ReleaseBodies.
+    ASTContext BodyASTContext;
+    bool SeparateBodies = false;
+    // Where the parser puts new nodes, the body arena while parsing a streamed body.
+    ASTContext *NodeContext = &TheASTContext;
+    SymbolTable Symbols;
+    unsigned NumScopes = 0;
+    // Shared with the JIT, which needs the context to outlive the parser's modules.
+    orc::ThreadSafeContext TSContext;
     IRBuilder<> *Builder;
     unique_ptr<Module> TheModule;
     std::unique_ptr<legacy::FunctionPassManager> TheFPM;
-    std::map<std::string, std::unique_ptr<PrototypeAST>> FunctionProtos;
+    DenseMap<Symbol, ASTPtr<PrototypeAST>> FunctionProtos;
+    DenseMap<Type *, ClassDeclAST *> ClassDecls;
+    Symbol OperatorSymbols[2][128];
     map<char, int> BinOpPrecedence;
     std::unique_ptr<Lexer> TheLexer;
     std::string TopFuncName;
     std::string Filename;
+    unsigned OptLevel;
+    // Interactive sessions run each top level expression as a function of its own.
+    bool Interactive = false;
+    unsigned NumExprs = 0;
+    ExprResultAST *LastExpr = nullptr;
+    Symbol LastExprName;
+    // With a tiered runtime, definitions are handed to it instead of generated.
+    TieredRuntime *Tiered = nullptr;
+    // Items are handed to the builder instead of generated, when there is one.
+    ItemBuilder *Items = nullptr;
 
     Token getCurTok() {
-        return TheLexer->CurTok;
+        return TheLexer->getCurToken();
     }
 
     Token SkipColon() {
@@ -712,37 +795,55 @@ class Parser {
         return getCurTok();
     }
 
-    int GetTokenPrecedence();
+    /// SkipItem - Error recovery, steps past the ';' or '}' that ends the
+    /// broken item, so parsing goes on with the next one. Always eats a token.
+    void SkipItem() {
+        int Depth = 0;
+        while (getCurTok() != tok_eof) {
+            Token Tok = getCurTok();
+            getNextToken();
+            if (Tok == tok_left_bracket)
+                Depth++;
+            else if ((Tok == tok_right_bracket && --Depth <= 0) || (Tok == tok_colon && Depth <= 0))
+                return;
+        }
+    }
 
-    VarType ParseType(shared_ptr<Scope> scope);
-
-    unique_ptr<ExprAST> ParseIntegerLiteral(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseFloatLiteral(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseParenExpr(shared_ptr<Scope> scope);
-    std::unique_ptr<ExprAST> ParseIdentifierExpr(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParsePrimary(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseExpr(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseBinOpRHS(shared_ptr<Scope> scope, int ExprPrec, unique_ptr<ExprAST> LHS);
-    unique_ptr<ExprAST> ParseIfExpr(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseForExpr(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseUnary(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseVarExpr(shared_ptr<Scope> scope);
-    unique_ptr<PrototypeAST> ParsePrototype(shared_ptr<Scope> scope, string &ClassName);
-    unique_ptr<FunctionAST> ParseDefinition(shared_ptr<Scope> scope);
-    unique_ptr<FunctionAST> ParseMethod(shared_ptr<Scope> scope, string &ClassName);
-    unique_ptr<PrototypeAST> ParseExtern(shared_ptr<Scope> scope);
-    unique_ptr<FunctionAST> ParseTopLevelExpr(shared_ptr<Scope> scope);
-    unique_ptr<MemberAST> ParseMemberAST(shared_ptr<Scope> scope);
-    unique_ptr<ClassDeclAST> ParseClassDecl(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseNew(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseDelete(shared_ptr<Scope> scope);
-    unique_ptr<ExprAST> ParseReturn(shared_ptr<Scope> scope);
+    int GetTokenPrecedence();
+    ASTContext *getBodyContext() { return SeparateBodies ? &BodyASTContext : &TheASTContext; }
+
+    VarType ParseType(Scope *scope);
+
+    ASTPtr<ExprAST> ParseIntegerLiteral(Scope *scope);
+    ASTPtr<ExprAST> ParseFloatLiteral(Scope *scope);
+    ASTPtr<ExprAST> ParseParenExpr(Scope *scope);
+    ASTPtr<ExprAST> ParseIdentifierExpr(Scope *scope);
+    ASTPtr<ExprAST> ParsePrimary(Scope *scope);
+    ASTPtr<ExprAST> ParseExpr(Scope *scope);
+    ASTPtr<ExprAST> ParseBinOpRHS(Scope *scope, int ExprPrec, ASTPtr<ExprAST> LHS);
+    ASTPtr<ExprAST> ParseIfExpr(Scope *scope);
+    ASTPtr<ExprAST> ParseForExpr(Scope *scope);
+    ASTPtr<ExprAST> ParseUnary(Scope *scope);
+    ASTPtr<ExprAST> ParseVarExpr(Scope *scope);
+    ASTPtr<PrototypeAST> ParsePrototype(Scope *scope, Symbol ClassName);
+    ASTPtr<FunctionAST> ParseDefinition(Scope *scope);
+    ASTPtr<FunctionAST> ParseMethod(Scope *scope, Symbol ClassName);
+    ASTPtr<PrototypeAST> ParseExtern(Scope *scope);
+    ASTPtr<FunctionAST> ParseTopLevelExpr(Scope *scope);
+    ASTPtr<MemberAST> ParseMemberAST(Scope *scope);
+    ASTPtr<ClassDeclAST> ParseClassDecl(Scope *scope);
+    ASTPtr<ExprAST> ParseNew(Scope *scope);
+    ASTPtr<ExprAST> ParseDelete(Scope *scope);
+    ASTPtr<ExprAST> ParseReturn(Scope *scope);
 
 public:
-    Parser(std::string src, std::string filename)
-    : TheLexer(std::make_unique<Lexer>(src)), Filename(filename) {
+    /// Tokens, when given, are taken from a lexer running on another thread.
+    /// Skimmed tokens, when given, are read instead of the buffers.
+    Parser(vector<StringRef> buffers, std::string filename, unsigned optLevel = 0, SPSCQueue<TokenInfo> *tokens = nullptr,
+           const SkimmedTokens *skimmed = nullptr)
+    : TSContext(std::make_unique<LLVMContext>()), TheLexer(std::make_unique<Lexer>(std::move(buffers), &Symbols, tokens, skimmed)), Filename(filename), OptLevel(optLevel) {
 
-        Builder = new IRBuilder<>(LLContext);
+        Builder = new IRBuilder<>(getContext());
 
         BinOpPrecedence[tok_equal] = 2;
         BinOpPrecedence[tok_less] = 10;
@@ -760,13 +861,14 @@ public:
 
     Token getNextToken();
     Token getCurToken() { return TheLexer->getCurToken(); }
-    SourceLocation getCurLoc() { return TheLexer->CurLoc; }
+    SourceLocation getCurLoc() { return TheLexer->getCurLoc(); }
     void InitializeModuleAndPassManager();
-    void HandleDefinition(shared_ptr<Scope> scope);
-    void HandleExtern(shared_ptr<Scope> scope);
-    void HandleTopLevelExpression(shared_ptr<Scope> scope);
+    void HandleDefinition(Scope *scope);
+    void HandleExtern(Scope *scope);
+    void HandleTopLevelExpression(Scope *scope);
+    void HandleTiered(FunctionAST *FnAST);
 
-    static AllocaInst *CreateEntryBlockAlloca(Function *F, Type *T, const string &VarName);
+    static AllocaInst *CreateEntryBlockAlloca(Function *F, Type *T, StringRef VarName);
     static AllocaInst *CreateEntryBlockAlloca(Function *F, VarExprAST *Var);
     void SetBinOpPrecedence(char Op, int Prec) {
         if (Prec >= 0) {
@@ -775,15 +877,76 @@ public:
             BinOpPrecedence.erase(Op);
         }
     };
-    void AddFunctionProtos(std::unique_ptr<PrototypeAST> Proto) {
-        FunctionProtos[Proto->getName()] = std::move(Proto);
-    }
-    Function *getFunction(std::string Name);
+    void AddFunctionProtos(ASTPtr<PrototypeAST> Proto) {
+        FunctionProtos[Proto->getSymbol()] = std::move(Proto);
+    }
+    Function *getFunction(Symbol Name);
+    Function *getFunction(StringRef Name) { return getFunction(Symbols.intern(Name)); }
+    /// getOperatorSymbol - Name of a user defined operator function, "binary+" or "unary!".
+    Symbol getOperatorSymbol(bool Binary, char Op) {
+        Symbol &S = OperatorSymbols[Binary][(unsigned char)Op & 127];
+        if (!S.isValid())
+            S = Symbols.intern(string(Binary ? "binary" : "unary") + Op);
+        return S;
+    }
+    void AddClassDecl(StructType *ST, ClassDeclAST *C) { ClassDecls[ST] = C; }
+    ClassDeclAST *getClassDecl(Type *T) const { return ClassDecls.lookup(T); }
     Module &getModule() const { return *TheModule.get(); };
-    LLVMContext &getContext() { return this->LLContext; };
+    ASTContext &getASTContext() { return TheASTContext; };
+    SymbolTable &getSymbols() { return Symbols; };
+    /// NewScope - Scopes share the AST arena and go away with ReleaseAST.
+    Scope *NewScope(Scope *Parent) {
+        return NodeContext->create<Scope>(Parent, ++NumScopes).release();
+    };
+    void ReleaseAST() {
+        FunctionProtos.clear();
+        ClassDecls.clear();
+        BodyASTContext.reset();
+        TheASTContext.reset();
+    };
+    /// SetSeparateBodies - Parse the bodies of functions and top level
+    /// expressions into an arena of their own, prototypes and classes stay.
+    void SetSeparateBodies() { SeparateBodies = true; };
+    /// ReleaseBodies - Drops the bodies parsed so far, once they are generated.
+    void ReleaseBodies() { BodyASTContext.reset(); };
+    LLVMContext &getContext() { return *TSContext.getContext(); };
+    orc::ThreadSafeContext getThreadSafeContext() { return TSContext; };
+    /// takeModule - Hands the module over, to the JIT for one. Call
+    /// InitializeModuleAndPassManager before generating code again.
+    unique_ptr<Module> takeModule() {
+        TheFPM.reset();
+        return std::move(TheModule);
+    };
     IRBuilder<> *getBuilder() { return Builder; };
-    void RunFunction(Function *F) { TheFPM->run(*F); };
+    void RunFunction(Function *F) {
+        if (!TheFPM)
+            return;
+        TimePhase Phase("fpm", "Function passes", F->getName());
+        TheFPM->run(*F);
+    };
+    unsigned getOptLevel() const { return OptLevel; };
+    size_t getNumTokens() const { return TheLexer->getNumTokens(); };
     void SetTopFuncName(std::string &FuncName) { TopFuncName = FuncName; };
+    /// SetInteractive - Generate top level expressions as __exprN functions
+    /// returning their value, instead of as the body of TopFuncName.
+    void SetInteractive() { Interactive = true; };
+    /// takeExpr - The top level expression generated since the last call, or
+    /// null. Name is set to its function.
+    ExprResultAST *takeExpr(Symbol &Name) {
+        auto *E = LastExpr;
+        Name = LastExprName;
+        LastExpr = nullptr;
+        return E;
+    };
+    /// SetTiered - Hand functions and classes to RT as they are parsed, it
+    /// interprets or compiles them later.
+    void SetTiered(TieredRuntime *RT) { Tiered = RT; };
+    /// SetItemBuilder - Hand functions, classes and top level expressions to
+    /// Builder as they are parsed.
+    void SetItemBuilder(ItemBuilder *Builder) { Items = Builder; };
+    /// appendInput - More source for the lexer once it has reached the end,
+    /// the text must stay alive as long as the parser.
+    void appendInput(StringRef Input) { TheLexer->appendBuffer(Input); };
     VarType getVarType(Token Tok) {
         switch (Tok) {
             case tok_type_void: return VarType(VarTypeVoid);
@@ -791,15 +954,18 @@ public:
             case tok_type_int: return VarType(VarTypeInt);
             case tok_type_float: return VarType(VarTypeFloat);
             case tok_type_string: return VarType(VarTypeString);
-            case tok_type_object: return VarType(VarTypeObject, TheLexer->IdentifierStr);
+            case tok_type_object: return VarType(VarTypeObject, TheLexer->getIdentifier().str());
             default: return VarType(VarTypeUnkown);
         }
     }
 };
 
-extern unique_ptr<Parser> TheParser;
+/// TheParser - The parser code is generated for on this thread. A thread
+/// generating code for another thread's parser sets it to that one.
+extern thread_local Parser *TheParser;
 
 inline LLVMContext &getContext() { return TheParser->getContext(); }
 inline IRBuilder<> *getBuilder() { return TheParser->getBuilder(); }
+inline Symbol intern(StringRef Name) { return TheParser->getSymbols().intern(Name); }
 
 #endif /* Parser_hpp */
@@ -0,0 +1,46 @@
+//
+//  Pipeline.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Pipeline.hpp"
+#include "GlobalVars.hpp"
+
+#include "llvm/Bitcode/BitcodeWriter.h"
+
+using namespace std;
+using namespace llvm;
+
+void PipelineBuild::endItem() {
+    unsigned Index = NumItems++;
+    // Externs since the last item are declared in the next one's module.
+    auto M = TheParser->takeModule();
+    TheParser->InitializeModuleAndPassManager();
+    if (verifyModule(*M, &ErrStream())) {
+        cerr << "LogError: invalid code in item " << Index << endl;
+        Failed = true;
+        return;
+    }
+
+    ShardItem Item{ Index, {} };
+    {
+        raw_svector_ostream OS(Item.Bitcode);
+        WriteBitcodeToFile(*M, OS);
+    }
+    // The IR is done with once it is written, free it before waiting on the back end.
+    M.reset();
+    Out.push(std::move(Item));
+}
+
+void PipelineBuild::addFunction(FunctionAST *F) {
+    F->codegen();
+    endItem();
+}
+
+void PipelineBuild::addClass(ClassDeclAST *C) {
+    C->codegen();
+    endItem();
+}
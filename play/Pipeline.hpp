@@ -0,0 +1,39 @@
+//
+//  Pipeline.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Pipeline_hpp
+#define Pipeline_hpp
+
+#include "Parallel.hpp"
+#include "Parser.hpp"
+#include "SPSCQueue.hpp"
+
+/// PipelineBuild - The middle stage of a pipelined compile. Every top level
+/// item is generated into a module of its own and sent on as bitcode to the
+/// back end stage, which optimizes it in a context of its own. An item with
+/// an empty Bitcode ends the stream.
+class PipelineBuild : public ItemBuilder {
+    SPSCQueue<ShardItem> &Out;
+    unsigned NumItems = 0;
+    bool Failed = false;
+
+    void endItem();
+
+public:
+    explicit PipelineBuild(SPSCQueue<ShardItem> &out) : Out(out) {}
+
+    void addFunction(FunctionAST *F) override;
+    void addClass(ClassDeclAST *C) override;
+
+    /// finish - Ends the stream, the back end stops after the last item.
+    void finish() { Out.push({ NumItems, {} }); }
+    /// failed - An item didn't verify.
+    bool failed() const { return Failed; }
+};
+
+#endif /* Pipeline_hpp */
@@ -0,0 +1,109 @@
+//
+//  SPSCQueue.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef SPSCQueue_hpp
+#define SPSCQueue_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "llvm/Support/MathExtras.h"
+
+/// SPSCQueue - A bounded ring between one producer and one consumer thread,
+/// without locks. push waits while the ring is full, so a fast stage can run
+/// at most Capacity values ahead of the stage after it. A waiting side spins
+/// a little, then sleeps until the other side moves, so a stalled stage
+/// doesn't hold a core.
+template <typename T>
+class SPSCQueue {
+    std::vector<T> Slots;
+    size_t Mask;
+    // Written by the consumer only, on a cache line apart from Tail.
+    std::atomic<size_t> Head{0};
+    char Pad[64 - sizeof(std::atomic<size_t>)];
+    // Written by the producer only.
+    std::atomic<size_t> Tail{0};
+    // How often each side had to wait, read once both are done.
+    unsigned NumFullWaits = 0;
+    unsigned NumEmptyWaits = 0;
+
+    static const unsigned SpinLimit = 64;
+    // Only taken to sleep and to wake a sleeper.
+    std::mutex Mutex;
+    std::condition_variable Wakeup;
+    std::atomic<unsigned> Sleepers{0};
+
+    /// wait - Returns once Blocked() is false, sleeping if spinning didn't do.
+    template <typename PredT>
+    void wait(PredT Blocked) {
+        for (unsigned i = 0; i < SpinLimit; i++) {
+            if (!Blocked())
+                return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> Lock(Mutex);
+        Sleepers.fetch_add(1);
+        // Pairs with the fence in wake: either this sees the move, or wake sees the sleeper.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (Blocked())
+            Wakeup.wait(Lock);
+        Sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /// wake - Called after moving Head or Tail, wakes the other side if it sleeps.
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (Sleepers.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            Wakeup.notify_one();
+        }
+    }
+
+public:
+    /// Capacity is rounded up to a power of two.
+    explicit SPSCQueue(size_t Capacity)
+        : Slots(llvm::PowerOf2Ceil(Capacity)), Mask(Slots.size() - 1) {}
+    SPSCQueue(const SPSCQueue &) = delete;
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    void push(T Value) {
+        size_t Pos = Tail.load(std::memory_order_relaxed);
+        if (Pos - Head.load(std::memory_order_acquire) == Slots.size()) {
+            NumFullWaits++;
+            wait([&] { return Pos - Head.load(std::memory_order_acquire) == Slots.size(); });
+        }
+        Slots[Pos & Mask] = std::move(Value);
+        Tail.store(Pos + 1, std::memory_order_release);
+        wake();
+    }
+
+    T pop() {
+        size_t Pos = Head.load(std::memory_order_relaxed);
+        if (Tail.load(std::memory_order_acquire) == Pos) {
+            NumEmptyWaits++;
+            wait([&] { return Tail.load(std::memory_order_acquire) == Pos; });
+        }
+        T Value = std::move(Slots[Pos & Mask]);
+        Head.store(Pos + 1, std::memory_order_release);
+        wake();
+        return Value;
+    }
+
+    size_t capacity() const { return Slots.size(); }
+    /// getNumFullWaits - Times the producer was held back.
+    unsigned getNumFullWaits() const { return NumFullWaits; }
+    /// getNumEmptyWaits - Times the consumer ran dry.
+    unsigned getNumEmptyWaits() const { return NumEmptyWaits; }
+};
+
+#endif /* SPSCQueue_hpp */
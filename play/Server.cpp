@@ -0,0 +1,325 @@
+//
+//  Server.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Server.hpp"
+#include "Driver.hpp"
+#include "GlobalVars.hpp"
+#include "Timing.hpp"
+#include "WorkPool.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <shared_mutex>
+#include <streambuf>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace std;
+using namespace llvm;
+
+// A request is "key=value" lines, the compile options plus "file" with the
+// absolute source path, or "stop". "out" is absolute too, the server writes
+// the object file there. The client half-closes the socket after it. The
+// reply is a "<status> <stdout size> <stderr size>" line followed by what the
+// compile printed to each, then the server closes the connection.
+
+string getDefaultSocketPath() {
+    return "/tmp/playc-" + to_string(getuid()) + ".sock";
+}
+
+static bool writeAll(int Fd, StringRef Data) {
+    while (!Data.empty()) {
+        ssize_t N = ::write(Fd, Data.data(), Data.size());
+        if (N < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        Data = Data.drop_front(N);
+    }
+    return true;
+}
+
+static bool readAll(int Fd, string &Out) {
+    char Buf[64 * 1024];
+    while (true) {
+        ssize_t N = ::read(Fd, Buf, sizeof(Buf));
+        if (N == 0)
+            return true;
+        if (N < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        Out.append(Buf, N);
+    }
+}
+
+static bool getSocketAddress(const string &Path, sockaddr_un &Addr) {
+    memset(&Addr, 0, sizeof(Addr));
+    Addr.sun_family = AF_UNIX;
+    if (Path.size() >= sizeof(Addr.sun_path)) {
+        cerr << "LogError: socket path too long: " << Path << endl;
+        return false;
+    }
+    strncpy(Addr.sun_path, Path.c_str(), sizeof(Addr.sun_path) - 1);
+    return true;
+}
+
+/// connectTo - A connection to the server at Path, -1 if none is listening.
+static int connectTo(const string &Path) {
+    sockaddr_un Addr;
+    if (!getSocketAddress(Path, Addr))
+        return -1;
+    int Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Fd < 0)
+        return -1;
+    if (connect(Fd, (sockaddr *)&Addr, sizeof(Addr)) < 0) {
+        close(Fd);
+        return -1;
+    }
+    return Fd;
+}
+
+/// request - Sends Request and reads back the reply. Returns false if there
+/// is no server or the reply is cut short.
+static bool request(const string &SocketPath, const string &Request, int &Status, string &Out, string &Err) {
+    int Fd = connectTo(SocketPath);
+    if (Fd < 0)
+        return false;
+
+    string Reply;
+    bool OK = writeAll(Fd, Request) && shutdown(Fd, SHUT_WR) == 0 && readAll(Fd, Reply);
+    close(Fd);
+    if (!OK)
+        return false;
+
+    StringRef Header, Body;
+    std::tie(Header, Body) = StringRef(Reply).split('\n');
+    SmallVector<StringRef, 3> Fields;
+    Header.split(Fields, ' ');
+    size_t OutSize, ErrSize;
+    if (Fields.size() != 3 || Fields[0].getAsInteger(10, Status) || Fields[1].getAsInteger(10, OutSize) ||
+        Fields[2].getAsInteger(10, ErrSize) || Body.size() != OutSize + ErrSize)
+        return false;
+    Out = Body.take_front(OutSize).str();
+    Err = Body.drop_front(OutSize).str();
+    return true;
+}
+
+/// CaptureBuf - Put in place of the cout and cerr buffers by the server. A
+/// thread whose output is captured writes into its capture, others go on
+/// writing to the terminal.
+class CaptureBuf : public streambuf {
+    streambuf *Terminal;
+    bool IsErr;
+
+    raw_ostream *getCapture() {
+        auto *Capture = CapturedOutput();
+        if (!Capture)
+            return nullptr;
+        return IsErr ? &Capture->ErrOS : &Capture->OutOS;
+    }
+
+protected:
+    int overflow(int C) override {
+        if (C == EOF)
+            return 0;
+        char Ch = (char)C;
+        return xsputn(&Ch, 1) == 1 ? C : EOF;
+    }
+    streamsize xsputn(const char *S, streamsize N) override {
+        if (auto *OS = getCapture()) {
+            OS->write(S, N);
+            return N;
+        }
+        return Terminal->sputn(S, N);
+    }
+    int sync() override {
+        return getCapture() ? 0 : Terminal->pubsync();
+    }
+
+public:
+    CaptureBuf(streambuf *terminal, bool isErr) : Terminal(terminal), IsErr(isErr) {}
+    streambuf *getTerminal() const { return Terminal; }
+};
+
+// Time reports and time traces are set up for the whole process, a request
+// asking for one runs alone, the others side by side.
+static shared_timed_mutex ReportLock;
+
+/// handle - Compiles one request and replies with its status and output.
+/// Returns false for a stop request.
+static bool handle(int Fd) {
+    string Request;
+    if (!readAll(Fd, Request))
+        return true;
+
+    map<string, string> opts;
+    SmallVector<StringRef, 16> Lines;
+    StringRef(Request).split(Lines, '\n', -1, false);
+    for (auto Line : Lines) {
+        auto KV = Line.split('=');
+        opts[KV.first.str()] = KV.second.str();
+    }
+    if (opts.count("stop")) {
+        writeAll(Fd, "0 0 0\n");
+        return false;
+    }
+
+    string Path = opts["file"];
+    opts.erase("file");
+    int Status = 1;
+    OutputCapture Capture;
+    {
+        CapturedOutput() = &Capture;
+        auto EndCapture = make_scope_exit([] { CapturedOutput() = nullptr; });
+        if (opts.count("time-report") || opts.count("time-trace")) {
+            lock_guard<shared_timed_mutex> Alone(ReportLock);
+            if (auto Src = SourceBuffer::getFile(Path))
+                Status = compile(Path, *Src, opts);
+            // Off again before the next compiles start next to each other.
+            InitTiming(false, false);
+        } else {
+            shared_lock<shared_timed_mutex> Shared(ReportLock);
+            if (auto Src = SourceBuffer::getFile(Path))
+                Status = compile(Path, *Src, opts);
+        }
+        // The next request on this thread traces only if it asks to.
+        DLogStream().flush();
+        DLogInit("", "");
+    }
+
+    writeAll(Fd, to_string(Status) + " " + to_string(Capture.Out.size()) + " " + to_string(Capture.Err.size()) + "\n");
+    writeAll(Fd, Capture.Out);
+    writeAll(Fd, Capture.Err);
+    return true;
+}
+
+int serve(const string &SocketPath) {
+    sockaddr_un Addr;
+    if (!getSocketAddress(SocketPath, Addr))
+        return 1;
+
+    // A client that went away must not take the server down with it.
+    signal(SIGPIPE, SIG_IGN);
+
+    int Fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Fd < 0) {
+        cerr << "LogError: socket: " << strerror(errno) << endl;
+        return 1;
+    }
+    // A socket file left by a server that was killed.
+    int Live = connectTo(SocketPath);
+    if (Live >= 0) {
+        close(Live);
+        close(Fd);
+        cerr << "LogError: a server is already listening on " << SocketPath << endl;
+        return 1;
+    }
+    unlink(SocketPath.c_str());
+    if (::bind(Fd, (sockaddr *)&Addr, sizeof(Addr)) < 0 || listen(Fd, 64) < 0) {
+        cerr << "LogError: can't listen on " << SocketPath << ": " << strerror(errno) << endl;
+        close(Fd);
+        return 1;
+    }
+    cout << "Listening on " << SocketPath << endl;
+
+    // What a compile prints goes back to its client.
+    CaptureBuf Out(cout.rdbuf(), false), Err(cerr.rdbuf(), true);
+    cout.rdbuf(&Out);
+    cerr.rdbuf(&Err);
+    auto RestoreStreams = make_scope_exit([&] {
+        cout.rdbuf(Out.getTerminal());
+        cerr.rdbuf(Err.getTerminal());
+    });
+
+    // Workers keep their target machines and pipelines from one request to
+    // the next, they are per thread.
+    WorkPool Pool;
+    atomic<bool> Stopping(false);
+    while (true) {
+        int Client = accept(Fd, nullptr, nullptr);
+        if (Client < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (Stopping) {
+            close(Client);
+            break;
+        }
+        Pool.async([Client, &Stopping, &SocketPath] {
+            bool KeepGoing = handle(Client);
+            close(Client);
+            if (!KeepGoing) {
+                Stopping = true;
+                // Wakes the accept loop up to see it.
+                int Wake = connectTo(SocketPath);
+                if (Wake >= 0)
+                    close(Wake);
+            }
+        });
+    }
+    Pool.wait();
+
+    close(Fd);
+    unlink(SocketPath.c_str());
+    return 0;
+}
+
+bool compileOnServer(const string &SocketPath, const string &Path, map<string, string> &opts, int &Status) {
+    SmallString<256> AbsPath(Path);
+    if (sys::fs::make_absolute(AbsPath))
+        return false;
+
+    auto Forwarded = opts;
+    // The server runs in a directory of its own, every path it writes to is made absolute.
+    if (!Forwarded.count("out"))
+        Forwarded["out"] = "output.o";
+    for (auto Key : { "out", "time-trace", "trace-file", "cache", "incremental" }) {
+        auto I = Forwarded.find(Key);
+        if (I == Forwarded.end() || I->second.empty())
+            continue;
+        SmallString<256> P(I->second);
+        if (!sys::fs::make_absolute(P))
+            I->second = P.str().str();
+    }
+
+    string Request = "file=" + AbsPath.str().str() + "\n";
+    for (auto &O : Forwarded) {
+        if (StringRef(O.second).contains('\n'))
+            continue;
+        Request += O.first + "=" + O.second + "\n";
+    }
+
+    string Out, Err;
+    if (!request(SocketPath, Request, Status, Out, Err))
+        return false;
+    cout << Out << flush;
+    cerr << Err << flush;
+    return true;
+}
+
+bool stopServer(const string &SocketPath) {
+    int Status;
+    string Out, Err;
+    return request(SocketPath, "stop=1\n", Status, Out, Err);
+}
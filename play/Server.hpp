@@ -0,0 +1,36 @@
+//
+//  Server.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Server_hpp
+#define Server_hpp
+
+#include <map>
+#include <string>
+
+/// getDefaultSocketPath - /tmp/playc-<uid>.sock, one server per user.
+std::string getDefaultSocketPath();
+
+/// serve - Runs a compile server on the Unix socket at SocketPath until it is
+/// killed or gets a stop request. Compiles run in process on a pool of worker
+/// threads, one per core, each keeping its target machines and pass pipelines
+/// warm between requests. A request with -trace, -time-report or -time-trace
+/// runs alone. What a compile prints goes back to its client, a failed one
+/// fails alone.
+int serve(const std::string &SocketPath);
+
+/// compileOnServer - Has the server compile the file at Path into
+/// opts["out"], and prints what the compile printed. Returns false if no
+/// server answers, the caller compiles in process then. Status is compile()'s
+/// result.
+bool compileOnServer(const std::string &SocketPath, const std::string &Path,
+                     std::map<std::string, std::string> &opts, int &Status);
+
+/// stopServer - Asks the server to exit. Returns false if none is running.
+bool stopServer(const std::string &SocketPath);
+
+#endif /* Server_hpp */
@@ -0,0 +1,24 @@
+//
+//  SourceBuffer.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "SourceBuffer.hpp"
+#include <iostream>
+
+using namespace std;
+using namespace llvm;
+
+unique_ptr<SourceBuffer> SourceBuffer::getFile(const string &Path) {
+    // The Lexer stops at the buffer end, so no null terminator is needed and
+    // files of a page multiple size can still be mapped.
+    auto BufOrErr = MemoryBuffer::getFileOrSTDIN(Path, -1, false);
+    if (auto EC = BufOrErr.getError()) {
+        cerr << "LogError: can't read " << Path << ": " << EC.message() << endl;
+        return nullptr;
+    }
+    return unique_ptr<SourceBuffer>(new SourceBuffer(std::move(*BufOrErr)));
+}
@@ -0,0 +1,33 @@
+//
+//  SourceBuffer.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef SourceBuffer_hpp
+#define SourceBuffer_hpp
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <memory>
+#include <string>
+
+/// SourceBuffer - Source text the Lexer scans in place. Large files are
+/// mapped with mmap, stdin is read in one go, nothing is copied afterwards.
+class SourceBuffer {
+    std::unique_ptr<llvm::MemoryBuffer> Buffer;
+
+    SourceBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer): Buffer(std::move(buffer)) {}
+
+public:
+    /// getFile - Open Path, or stdin for "-". Returns nullptr if it can't be read.
+    static std::unique_ptr<SourceBuffer> getFile(const std::string &Path);
+
+    llvm::StringRef getBuffer() const { return Buffer->getBuffer(); }
+    llvm::StringRef getName() const { return Buffer->getBufferIdentifier(); }
+};
+
+#endif /* SourceBuffer_hpp */
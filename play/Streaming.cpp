@@ -0,0 +1,112 @@
+//
+//  Streaming.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Streaming.hpp"
+#include "GlobalVars.hpp"
+
+#include <algorithm>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+using namespace std;
+using namespace llvm;
+
+StreamBuild::StreamBuild(PrepareFunction prepare, EmitFunction emit)
+    : Prepare(std::move(prepare)), Emit(std::move(emit)) {
+    if (auto EC = sys::fs::createUniqueDirectory("playc-stream", Dir)) {
+        cerr << "LogError: can't create a directory for chunks: " << EC.message() << endl;
+        Failed = true;
+    }
+}
+
+StreamBuild::~StreamBuild() {
+    for (auto &Object : Objects)
+        sys::fs::remove(Object);
+    if (!Dir.empty())
+        sys::fs::remove(Dir);
+}
+
+void StreamBuild::endItem() {
+    NumItems++;
+    // The IR holds everything the body had to say.
+    TheParser->ReleaseBodies();
+    if (ChunkSize >= ChunkInstructions)
+        emitChunk(false);
+}
+
+void StreamBuild::emitChunk(bool Last) {
+    auto M = TheParser->takeModule();
+    TheParser->InitializeModuleAndPassManager();
+    unsigned Size = ChunkSize;
+    ChunkSize = 0;
+    // Declarations alone need no object, unless nothing else would be linked.
+    if (Failed || (!Size && !(Last && Objects.empty())))
+        return;
+    LargestChunk = std::max(LargestChunk, Size);
+
+    if (verifyModule(*M, &ErrStream())) {
+        cerr << "LogError: invalid code in chunk " << Objects.size() << endl;
+        Failed = true;
+        return;
+    }
+    Prepare(*M);
+    if (DLogEnabled(DLT_IR)) {
+        DLogStream() << "### Chunk " << Objects.size() << " Bitcode ###\n";
+        M->print(DLogStream(), nullptr);
+    }
+
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, "chunk" + to_string(Objects.size()) + ".o");
+    error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_None);
+    if (EC) {
+        cerr << "LogError: can't write " << Path.str().str() << ": " << EC.message() << endl;
+        Failed = true;
+        return;
+    }
+    Objects.push_back(Path.str().str());
+    TimePhase Phase("emit", "Object emission");
+    if (!Emit(*M, OS))
+        Failed = true;
+}
+
+void StreamBuild::addFunction(FunctionAST *F) {
+    if (auto *Fn = F->codegen())
+        ChunkSize += Fn->getInstructionCount();
+    endItem();
+}
+
+void StreamBuild::addClass(ClassDeclAST *C) {
+    // Codegen hands the prototypes over to the parser, the names are taken first.
+    SmallVector<Symbol, 8> Methods;
+    for (size_t i = 0; i < C->getNumMethods(); i++)
+        Methods.push_back(C->getMethod(i)->getProto().getSymbol());
+    C->codegen();
+    for (auto Name : Methods) {
+        if (auto *Fn = TheParser->getModule().getFunction(Name.str()))
+            ChunkSize += Fn->getInstructionCount();
+    }
+    endItem();
+}
+
+bool StreamBuild::finish(StringRef Output) {
+    emitChunk(true);
+    if (Failed)
+        return false;
+
+    TimePhase Phase("link", "Link chunks");
+    return linkObjects(Objects, Dir, Output);
+}
+
+void StreamBuild::printStats(raw_ostream &OS) const {
+    OS << "### Streaming Stats ###\n";
+    OS << "items: " << NumItems << ", chunks: " << Objects.size() << ", largest chunk: " << LargestChunk
+       << " instructions\n";
+}
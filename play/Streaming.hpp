@@ -0,0 +1,64 @@
+//
+//  Streaming.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Streaming_hpp
+#define Streaming_hpp
+
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "BuildSupport.hpp"
+#include "Parser.hpp"
+
+/// StreamBuild - Compiles a file in chunks as it is parsed. Items are
+/// generated into the parser's module until it holds ChunkInstructions, then
+/// the chunk is optimized and emitted as an object file of its own, and its
+/// IR is freed. The body of every item is dropped as soon as it is generated.
+/// finish joins the chunk objects into the output with a relocatable link,
+/// so memory follows the largest chunk and not the whole file.
+class StreamBuild : public ItemBuilder {
+public:
+    /// Instructions a chunk collects before it is emitted.
+    static const unsigned ChunkInstructions = 20000;
+
+private:
+    PrepareFunction Prepare;
+    EmitFunction Emit;
+    llvm::SmallString<128> Dir;
+    std::vector<std::string> Objects;
+    /// Instructions generated into the chunk so far.
+    unsigned ChunkSize = 0;
+    unsigned NumItems = 0;
+    unsigned LargestChunk = 0;
+    bool Failed = false;
+
+    void endItem();
+    /// emitChunk - The last chunk is emitted even when empty, if it is the only one.
+    void emitChunk(bool Last);
+
+public:
+    /// Prepare sets up a chunk for the target and optimizes it, Emit writes
+    /// its object file.
+    StreamBuild(PrepareFunction prepare, EmitFunction emit);
+    ~StreamBuild();
+
+    void addFunction(FunctionAST *F) override;
+    void addClass(ClassDeclAST *C) override;
+
+    /// finish - Emits the last chunk and links every chunk into Output.
+    /// Returns false if a chunk or the link failed.
+    bool finish(llvm::StringRef Output);
+
+    void printStats(llvm::raw_ostream &OS) const;
+};
+
+#endif /* Streaming_hpp */
@@ -0,0 +1,67 @@
+//
+//  Symbol.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Symbol_hpp
+#define Symbol_hpp
+
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+/// Symbol - An interned name. Equal names share one table entry, so symbols
+/// compare and hash as pointers while the text stays one hop away.
+class Symbol {
+    const llvm::StringMapEntry<char> *Entry = nullptr;
+
+public:
+    Symbol() {}
+    explicit Symbol(const llvm::StringMapEntry<char> *entry): Entry(entry) {}
+
+    bool isValid() const { return Entry != nullptr; }
+    llvm::StringRef str() const { return Entry ? Entry->getKey() : llvm::StringRef(); }
+    /// c_str - Table keys are stored null terminated, so this never copies.
+    const char *c_str() const { return Entry ? Entry->getKeyData() : ""; }
+    const void *getOpaqueValue() const { return Entry; }
+
+    bool operator==(const Symbol &Other) const { return Entry == Other.Entry; }
+    bool operator!=(const Symbol &Other) const { return Entry != Other.Entry; }
+};
+
+namespace llvm {
+template <> struct DenseMapInfo<Symbol> {
+    static Symbol getEmptyKey() {
+        return Symbol((const StringMapEntry<char> *)DenseMapInfo<const void *>::getEmptyKey());
+    }
+    static Symbol getTombstoneKey() {
+        return Symbol((const StringMapEntry<char> *)DenseMapInfo<const void *>::getTombstoneKey());
+    }
+    static unsigned getHashValue(const Symbol &S) {
+        return DenseMapInfo<const void *>::getHashValue(S.getOpaqueValue());
+    }
+    static bool isEqual(const Symbol &LHS, const Symbol &RHS) { return LHS == RHS; }
+};
+}
+
+/// SymbolTable - Interns names for one compilation unit, entries live as long as the table.
+class SymbolTable {
+    llvm::StringMap<char, llvm::BumpPtrAllocator> Names;
+
+public:
+    Symbol intern(llvm::StringRef Name) {
+        return Symbol(&*Names.try_emplace(Name, 0).first);
+    }
+    /// lookup - Like intern but never adds, returns an invalid symbol for unknown names.
+    Symbol lookup(llvm::StringRef Name) const {
+        auto I = Names.find(Name);
+        return I == Names.end() ? Symbol() : Symbol(&*I);
+    }
+    size_t size() const { return Names.size(); }
+};
+
+#endif /* Symbol_hpp */
@@ -0,0 +1,286 @@
+//
+//  Tiered.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Tiered.hpp"
+#include "GlobalVars.hpp"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+
+using namespace std;
+using namespace llvm;
+
+static bool isScalar(const VarType &T) {
+    return T.TypeID == VarTypeBool || T.TypeID == VarTypeInt || T.TypeID == VarTypeFloat;
+}
+
+TieredFunction::TieredFunction(FunctionAST *F)
+    : AST(F), Proto(&F->getProto()), Body(F->getBody()), Name(Proto->getSymbol()), RetType(Proto->getRetType()) {
+    for (size_t i = 0; i < Proto->getNumArgs(); i++) {
+        ArgTypes.push_back(Proto->getArgType(i));
+        ArgSymbols.push_back(Proto->getArgSymbol(i));
+    }
+    Scalar = RetType.TypeID == VarTypeVoid || isScalar(RetType);
+    for (auto &T : ArgTypes)
+        Scalar &= isScalar(T);
+}
+
+void TieredRuntime::addFunction(FunctionAST *F) {
+    Order.push_back(make_unique<TieredFunction>(F));
+    auto *TF = Order.back().get();
+    Functions[TF->Name] = TF;
+    if (TF->Proto->isUnaryOp() || TF->Proto->isBinaryOp())
+        Operators[TF->Proto->isBinaryOp() << 8 | (unsigned char)TF->Proto->getOperatorName()] = TF;
+}
+
+bool FlatInterpretable::visitVar(unsigned N, const FlatNode &Node) {
+    if (!isScalar(AST.getType(Node)))
+        return false;
+    return all(Node);
+}
+
+bool FlatInterpretable::visitBinary(unsigned N, const FlatNode &Node) {
+    if (Node.Op == tok_equal) {
+        // The left side is a RightValue around what is assigned.
+        auto &LHS = AST.getNode(AST.getChild(Node, 0));
+        return AST.getNode(AST.getChild(LHS, 0)).Kind == FK_Variable && visitChild(Node, 1);
+    }
+    switch (Node.Op) {
+        case tok_add:
+        case tok_sub:
+        case tok_mul:
+        case tok_div:
+        case tok_less:
+        case tok_greater:
+            break;
+        default:
+            if (!RT.getOperator(true, Node.Op))
+                return false;
+    }
+    return all(Node);
+}
+
+bool FlatInterpretable::visitCall(unsigned N, const FlatNode &Node) {
+    // Externs and constructors only exist as native code.
+    auto *F = RT.getFunction(AST.getName(Node));
+    if (!F || !F->Scalar || F->ArgTypes.size() != Node.NumChildren)
+        return false;
+    return all(Node);
+}
+
+bool FlatInterpretable::visitUnary(unsigned N, const FlatNode &Node) {
+    if (Node.Op != tok_sub && Node.Op != tok_add && !RT.getOperator(false, Node.Op))
+        return false;
+    return all(Node);
+}
+
+bool TieredRuntime::start() {
+    SmallVector<TieredFunction *, 8> Eager;
+    // One body at a time, each is flattened and walked once.
+    FlatAST Flat;
+    FlatInterpretable Analysis(Flat, *this);
+    for (auto &F : Order) {
+        if (F->Scalar) {
+            Flat.clear();
+            F->Interpretable = Analysis.visit(Flat.add(F->Body));
+        }
+        if (!F->Interpretable)
+            Eager.push_back(F.get());
+        DLog(DLT_OTH, string("tier 0 ") + (F->Interpretable ? "runs " : "can't run ") + F->Name.c_str());
+    }
+    if ((!Eager.empty() || !Classes.empty()) && !compile(Eager))
+        return false;
+
+    // Code is generated for this thread's parser, and traced like it.
+    auto *P = TheParser;
+    Compiler = std::thread([this, P, Mask = DLogMask(), File = DLogFile()] {
+        TheParser = P;
+        DLogMask() = Mask;
+        DLogFile() = File;
+        compileLoop();
+    });
+    return true;
+}
+
+void TieredRuntime::stop() {
+    {
+        lock_guard<mutex> Lock(QueueLock);
+        Stopping = true;
+    }
+    QueueChanged.notify_all();
+    if (Compiler.joinable())
+        Compiler.join();
+}
+
+void TieredRuntime::requestCompile(TieredFunction &F) {
+    if (F.Queued)
+        return;
+    F.Queued = true;
+    {
+        lock_guard<mutex> Lock(QueueLock);
+        Queue.push_back(&F);
+    }
+    QueueChanged.notify_one();
+}
+
+void TieredRuntime::countBackEdge(TieredFunction &F) {
+    if (++F.BackEdges == HotBackEdges)
+        requestCompile(F);
+}
+
+void TieredRuntime::compileLoop() {
+    while (true) {
+        TieredFunction *F;
+        {
+            unique_lock<mutex> Lock(QueueLock);
+            QueueChanged.wait(Lock, [this] { return Stopping || !Queue.empty(); });
+            if (Stopping)
+                return;
+            F = Queue.front();
+            Queue.pop_front();
+        }
+        compile(F);
+    }
+}
+
+InterpValue TieredRuntime::call(TieredFunction &F, ArrayRef<InterpValue> Args) {
+    if (auto Entry = F.Native.load(memory_order_acquire)) {
+        NumNativeCalls++;
+        SmallVector<uint64_t, 8> Bits;
+        for (size_t i = 0; i < Args.size(); i++)
+            Bits.push_back(Args[i].convertTo(F.ArgTypes[i]).getBits());
+        return InterpValue::fromBits(F.RetType, Entry(Bits.data()));
+    }
+
+    // Compiled up front by start(), unless that failed.
+    if (!F.Interpretable) {
+        LogError(string("no native code for ") + F.Name.c_str());
+        return InterpValue();
+    }
+
+    NumInterpretedCalls++;
+    if (++F.Calls == HotCalls)
+        requestCompile(F);
+
+    InterpFrame Frame(*this, F);
+    for (size_t i = 0; i < Args.size(); i++)
+        Frame.set(F.Body->getScope(), F.ArgSymbols[i], Args[i].convertTo(F.ArgTypes[i]));
+    F.Body->interpret(Frame);
+    return Frame.RetVal.convertTo(F.RetType);
+}
+
+/// EmitEntry - The NativeEntry of F, named __tier_F. F is scalar.
+static void EmitEntry(Module &M, Function *F) {
+    auto &Ctx = M.getContext();
+    auto *I64 = Type::getInt64Ty(Ctx);
+    auto *FT = FunctionType::get(I64, { I64->getPointerTo() }, false);
+    auto *Entry = Function::Create(FT, Function::ExternalLinkage, "__tier_" + F->getName(), M);
+    IRBuilder<> B(BasicBlock::Create(Ctx, "entry", Entry));
+
+    SmallVector<Value *, 8> Args;
+    for (auto &A : F->args()) {
+        Value *Bits = B.CreateLoad(B.CreateConstGEP1_64(&*Entry->arg_begin(), A.getArgNo()));
+        auto *T = A.getType();
+        Args.push_back(T->isDoubleTy() ? B.CreateBitCast(Bits, T) : B.CreateTrunc(Bits, T));
+    }
+    Value *R = B.CreateCall(F, Args);
+
+    auto *RT = F->getReturnType();
+    if (RT->isVoidTy())
+        R = ConstantInt::get(I64, 0);
+    else if (RT->isDoubleTy())
+        R = B.CreateBitCast(R, I64);
+    else
+        R = B.CreateZExt(R, I64);
+    B.CreateRet(R);
+}
+
+bool TieredRuntime::compile(ArrayRef<TieredFunction *> Roots) {
+    lock_guard<mutex> Lock(CompileLock);
+    auto &M = TheParser->getModule();
+
+    // Declare everything first, calls into other modules resolve by symbol.
+    for (auto &F : Order) {
+        if (!M.getFunction(F->Name.str()))
+            const_cast<PrototypeAST *>(F->Proto)->codegen();
+    }
+    for (auto *C : Classes)
+        C->codegen();
+    Classes.clear();
+
+    SmallVector<TieredFunction *, 8> Batch;
+    for (auto *F : Roots) {
+        if (F->Compiled)
+            continue;
+        F->Compiled = true;
+        F->AST->codegen();
+        Batch.push_back(F);
+    }
+
+    // Native code can't call back into tier 0, pull in every callee that
+    // isn't compiled yet until the module is closed.
+    for (bool Changed = true; Changed;) {
+        Changed = false;
+        for (auto &IRF : M) {
+            for (auto &I : instructions(IRF)) {
+                auto *Call = dyn_cast<CallInst>(&I);
+                auto *Callee = Call ? Call->getCalledFunction() : nullptr;
+                if (!Callee || !Callee->isDeclaration())
+                    continue;
+                auto *F = getFunction(TheParser->getSymbols().lookup(Callee->getName()));
+                if (!F || F->Compiled)
+                    continue;
+                F->Compiled = true;
+                F->AST->codegen();
+                Batch.push_back(F);
+                Changed = true;
+            }
+            // New bodies may come earlier in the list, walk it again.
+            if (Changed)
+                break;
+        }
+    }
+
+    for (auto *F : Batch) {
+        if (F->Scalar)
+            EmitEntry(M, M.getFunction(F->Name.str()));
+    }
+
+    auto Mod = TheParser->takeModule();
+    TheParser->InitializeModuleAndPassManager();
+    // Only declarations and class types, nothing to run.
+    if (none_of(*Mod, [](Function &F) { return !F.isDeclaration(); }))
+        return true;
+    if (verifyModule(*Mod, &ErrStream())) {
+        cerr << "LogError: invalid code, can't compile" << endl;
+        return false;
+    }
+
+    Prepare(*Mod);
+    if (!JIT.addModule(orc::ThreadSafeModule(std::move(Mod), TheParser->getThreadSafeContext()), false))
+        return false;
+
+    for (auto *F : Batch) {
+        NumCompiled++;
+        DLog(DLT_OTH, string("tier 1 ") + F->Name.c_str());
+        if (!F->Scalar)
+            continue;
+        auto Addr = JIT.lookup(("__tier_" + F->Name.str()).str());
+        if (!Addr)
+            return false;
+        F->Native.store((NativeEntry)Addr, memory_order_release);
+    }
+    return true;
+}
+
+void TieredRuntime::printStats(raw_ostream &OS) const {
+    OS << "### Tiered Stats ###\n";
+    OS << "functions: " << Order.size() << ", compiled: " << NumCompiled.load() << "\n";
+    OS << "interpreted calls: " << NumInterpretedCalls << ", calls from tier 0 into native code: " << NumNativeCalls << "\n";
+}
@@ -0,0 +1,154 @@
+//
+//  Tiered.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Tiered_hpp
+#define Tiered_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "BuildSupport.hpp"
+#include "Parser.hpp"
+#include "FlatAST.hpp"
+#include "JIT.hpp"
+
+/// NativeEntry - Uniform entry emitted next to each compiled function, takes
+/// the arguments as i64 bits and returns the result the same way.
+using NativeEntry = uint64_t (*)(const uint64_t *Args);
+
+/// TieredFunction - A function as the tiered runtime runs it. The prototype
+/// is copied out at parse time, codegen takes it from the FunctionAST.
+struct TieredFunction {
+    FunctionAST *AST;
+    const PrototypeAST *Proto;
+    ExprAST *Body;
+    Symbol Name;
+    VarType RetType;
+    std::vector<VarType> ArgTypes;
+    std::vector<Symbol> ArgSymbols;
+    /// Scalar - Takes and returns only int, bool and float, the values tier 0
+    /// and a NativeEntry pass. Other functions are only called from native code.
+    bool Scalar;
+    bool Interpretable = false;
+
+    // Owned by the interpreting thread.
+    unsigned Calls = 0;
+    unsigned BackEdges = 0;
+    bool Queued = false;
+    // Owned by whoever holds the compile lock.
+    bool Compiled = false;
+
+    /// Native - Set once the function is compiled, calls go there from then on.
+    std::atomic<NativeEntry> Native{nullptr};
+
+    explicit TieredFunction(FunctionAST *F);
+};
+
+/// TieredRuntime - Runs a program by interpreting its AST first. Functions
+/// called or looping often enough are compiled on a background thread, and
+/// calls switch to the native code once it is ready. A running interpreted
+/// call isn't replaced, only the calls after the swap go native. Functions
+/// tier 0 can't run, those using classes or pointers, are compiled up front.
+class TieredRuntime {
+public:
+    /// Prepare sets up each module for the JIT and optimizes it.
+    TieredRuntime(PlayJIT &jit, PrepareFunction prepare): JIT(jit), Prepare(std::move(prepare)) {}
+    ~TieredRuntime() { stop(); }
+
+    /// Calls before the function turns hot, and loop iterations.
+    static const unsigned HotCalls = 100;
+    static const unsigned HotBackEdges = 10000;
+
+    void addFunction(FunctionAST *F);
+    void addClass(ClassDeclAST *C) { Classes.push_back(C); }
+
+    /// start - Decides what tier 0 can run, compiles the rest and starts the
+    /// compile thread. Returns false if the up front compile fails.
+    bool start();
+    /// stop - Waits for a running compile, drops the queued ones.
+    void stop();
+
+    TieredFunction *getFunction(Symbol Name) const { return Functions.lookup(Name); }
+    /// getOperator - The user defined operator, "binary+" or "unary!", null if none.
+    TieredFunction *getOperator(bool Binary, char Op) const { return Operators.lookup(Binary << 8 | (unsigned char)Op); }
+
+    /// call - Runs F natively if it has been compiled, interprets it otherwise.
+    InterpValue call(TieredFunction &F, llvm::ArrayRef<InterpValue> Args);
+    void countBackEdge(TieredFunction &F);
+
+    void printStats(llvm::raw_ostream &OS) const;
+
+private:
+    PlayJIT &JIT;
+    PrepareFunction Prepare;
+    std::vector<std::unique_ptr<TieredFunction>> Order;
+    llvm::DenseMap<Symbol, TieredFunction *> Functions;
+    llvm::DenseMap<unsigned, TieredFunction *> Operators;
+    std::vector<ClassDeclAST *> Classes;
+
+    std::mutex CompileLock;
+    std::mutex QueueLock;
+    std::condition_variable QueueChanged;
+    std::deque<TieredFunction *> Queue;
+    bool Stopping = false;
+    std::thread Compiler;
+
+    size_t NumInterpretedCalls = 0;
+    size_t NumNativeCalls = 0;
+    std::atomic<unsigned> NumCompiled{0};
+
+    void requestCompile(TieredFunction &F);
+    void compileLoop();
+    /// compile - Generates Roots and every function they call that isn't
+    /// compiled yet into one module, and swaps them all to native code.
+    bool compile(llvm::ArrayRef<TieredFunction *> Roots);
+};
+
+/// FlatInterpretable - Whether tier 0 can run an expression, walked over its
+/// flat form. Every node it accepts has an ExprAST::interpret, calls must go
+/// to scalar functions and assignments to plain variables.
+class FlatInterpretable : public FlatVisitor<FlatInterpretable, bool> {
+    const TieredRuntime &RT;
+
+    bool all(const FlatNode &Node) {
+        for (unsigned I = 0; I < Node.NumChildren; I++) {
+            if (hasChild(Node, I) && !visitChild(Node, I))
+                return false;
+        }
+        return true;
+    }
+
+public:
+    FlatInterpretable(const FlatAST &ast, const TieredRuntime &rt) : FlatVisitor(ast), RT(rt) {}
+
+    bool visitNode(unsigned N, const FlatNode &Node) { return false; }
+    bool visitIntegerLiteral(unsigned N, const FlatNode &Node) { return true; }
+    bool visitFloatLiteral(unsigned N, const FlatNode &Node) { return true; }
+    bool visitVariable(unsigned N, const FlatNode &Node) { return true; }
+    bool visitRightValue(unsigned N, const FlatNode &Node) { return all(Node); }
+    bool visitCompound(unsigned N, const FlatNode &Node) { return all(Node); }
+    bool visitIf(unsigned N, const FlatNode &Node) { return all(Node); }
+    bool visitFor(unsigned N, const FlatNode &Node) { return all(Node); }
+    bool visitReturn(unsigned N, const FlatNode &Node) { return all(Node); }
+    bool visitVar(unsigned N, const FlatNode &Node);
+    bool visitBinary(unsigned N, const FlatNode &Node);
+    bool visitCall(unsigned N, const FlatNode &Node);
+    bool visitUnary(unsigned N, const FlatNode &Node);
+};
+
+#endif /* Tiered_hpp */
@@ -0,0 +1,142 @@
+//
+//  Timing.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "Timing.hpp"
+#include <iostream>
+#include <memory>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/TimeProfiler.h"
+
+using namespace std;
+using namespace llvm;
+
+// Each thread of a batch compile collects the phases of its own file.
+static thread_local map<string, double> *PhaseTimes = nullptr;
+// Timers and the trace aren't thread safe, only the thread that turned them
+// on is timed. Background compiles go uncounted.
+static thread_local bool ReportEnabled = false;
+static thread_local bool Timed = false;
+
+static TimerGroup &getPhaseGroup() {
+    static TimerGroup Group("phases", "Compile phases");
+    return Group;
+}
+
+static TimerGroup &getFunctionGroup() {
+    static TimerGroup Group("functions", "Per function IR generation and function passes");
+    return Group;
+}
+
+static StringMap<unique_ptr<Timer>> PhaseTimers;
+static StringMap<unique_ptr<Timer>> FunctionTimers;
+
+/// getTimer - Timers are created on first use and live until exit, like NamedRegionTimer's.
+static Timer *getTimer(StringMap<unique_ptr<Timer>> &Timers, TimerGroup &Group,
+                       StringRef Name, StringRef Description) {
+    auto &T = Timers[Name];
+    if (!T)
+        T = make_unique<Timer>(Name, Description, Group);
+    return T.get();
+}
+
+static unique_ptr<PassInstrumentationCallbacks> PIC;
+static unique_ptr<TimePassesHandler> TimePasses;
+
+void InitTiming(bool Report, bool Trace) {
+    ReportEnabled = Report;
+    Timed = Report || Trace;
+    // Legacy pass managers (function passes, object emission) time their passes
+    // too. The flag is global, it is only written when it changes.
+    if (TimePassesIsEnabled != Report)
+        TimePassesIsEnabled = Report;
+    if (Report && !PIC) {
+        PIC = make_unique<PassInstrumentationCallbacks>();
+        TimePasses = make_unique<TimePassesHandler>(true);
+        TimePasses->registerCallbacks(*PIC);
+    }
+    if (Trace && !timeTraceProfilerEnabled())
+        timeTraceProfilerInitialize();
+}
+
+bool isTimeReportEnabled() {
+    return ReportEnabled;
+}
+
+PassInstrumentationCallbacks *getPassInstrumentation() {
+    return ReportEnabled ? PIC.get() : nullptr;
+}
+
+void PrintTimeReport(raw_ostream &OS) {
+    if (!ReportEnabled)
+        return;
+    getPhaseGroup().print(OS);
+    getPhaseGroup().clear();
+    getFunctionGroup().print(OS);
+    getFunctionGroup().clear();
+    // TimePassesHandler writes to the -info-output-file stream, stderr by default.
+    if (TimePasses)
+        TimePasses->print();
+    reportAndResetTimings(&OS);
+}
+
+void CollectPhaseTimes(map<string, double> *Out) {
+    PhaseTimes = Out;
+}
+
+bool WriteTimeTrace(StringRef Path) {
+    if (!timeTraceProfilerEnabled())
+        return true;
+    error_code EC;
+    raw_fd_ostream OS(Path, EC, sys::fs::OF_Text);
+    if (EC) {
+        cerr << "LogError: can't write time trace " << Path.str() << ": " << EC.message() << endl;
+        return false;
+    }
+    timeTraceProfilerWrite(OS);
+    timeTraceProfilerCleanup();
+    return true;
+}
+
+TimePhase::TimePhase(StringRef Name, StringRef Description, StringRef Function) {
+    if (PhaseTimes) {
+        WallSeconds = &(*PhaseTimes)[Name.str()];
+        Start = chrono::steady_clock::now();
+    }
+    if (!Timed)
+        return;
+    if (ReportEnabled) {
+        PhaseTimer = getTimer(PhaseTimers, getPhaseGroup(), Name, Description);
+        PhaseTimer->startTimer();
+        if (!Function.empty()) {
+            FunctionTimer = getTimer(FunctionTimers, getFunctionGroup(), Function, Function);
+            FunctionTimer->startTimer();
+        }
+    }
+    if (timeTraceProfilerEnabled()) {
+        timeTraceProfilerBegin(Description, Function);
+        Traced = true;
+    }
+}
+
+void TimePhase::end() {
+    if (FunctionTimer)
+        FunctionTimer->stopTimer();
+    if (PhaseTimer)
+        PhaseTimer->stopTimer();
+    if (Traced)
+        timeTraceProfilerEnd();
+    if (WallSeconds)
+        *WallSeconds += chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+    PhaseTimer = FunctionTimer = nullptr;
+    Traced = false;
+    WallSeconds = nullptr;
+}
@@ -0,0 +1,57 @@
+//
+//  Timing.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef Timing_hpp
+#define Timing_hpp
+
+#include <chrono>
+#include <map>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// InitTiming - Turns the -time-report timers and the -time-trace profiler on
+/// or off for this thread.
+void InitTiming(bool Report, bool Trace);
+bool isTimeReportEnabled();
+
+/// getPassInstrumentation - Callbacks timing each new pass manager pass, null
+/// unless -time-report is on for this thread.
+llvm::PassInstrumentationCallbacks *getPassInstrumentation();
+
+/// PrintTimeReport - Phases, functions and passes, slowest first. Resets the timers.
+void PrintTimeReport(llvm::raw_ostream &OS);
+
+/// CollectPhaseTimes - Adds the wall seconds of every phase run on this thread
+/// to Out until called again with null. Works without -time-report.
+void CollectPhaseTimes(std::map<std::string, double> *Out);
+
+/// WriteTimeTrace - Saves the trace as Chrome trace event JSON, for
+/// chrome://tracing or speedscope. Returns false if the file can't be written.
+bool WriteTimeTrace(llvm::StringRef Path);
+
+/// TimePhase - Charges the time until end() to a compile phase, and to Function
+/// when one is given. Timers and the trace only run on the thread that called
+/// InitTiming, wall seconds are collected on any thread.
+class TimePhase {
+    llvm::Timer *PhaseTimer = nullptr;
+    llvm::Timer *FunctionTimer = nullptr;
+    bool Traced = false;
+    double *WallSeconds = nullptr;
+    std::chrono::steady_clock::time_point Start;
+
+public:
+    TimePhase(llvm::StringRef Name, llvm::StringRef Description, llvm::StringRef Function = llvm::StringRef());
+    ~TimePhase() { end(); }
+    void end();
+};
+
+#endif /* Timing_hpp */
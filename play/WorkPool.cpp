@@ -0,0 +1,107 @@
+//
+//  WorkPool.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "WorkPool.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkPool::WorkPool(unsigned NumThreads) {
+    if (!NumThreads)
+        NumThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned i = 0; i < NumThreads; i++)
+        Queues.push_back(make_unique<Queue>());
+    for (unsigned i = 0; i < NumThreads; i++)
+        Threads.emplace_back([this, i] { run(i); });
+}
+
+WorkPool::~WorkPool() {
+    {
+        lock_guard<mutex> Guard(Lock);
+        Stopping = true;
+    }
+    WorkAvailable.notify_all();
+    for (auto &T : Threads)
+        T.join();
+}
+
+void WorkPool::async(Task T) {
+    unsigned Worker;
+    {
+        lock_guard<mutex> Guard(Lock);
+        Worker = NextQueue++ % Queues.size();
+        NumQueued++;
+        NumPending++;
+    }
+    {
+        lock_guard<mutex> Guard(Queues[Worker]->Lock);
+        Queues[Worker]->Tasks.push_back(std::move(T));
+    }
+    WorkAvailable.notify_one();
+}
+
+void WorkPool::wait() {
+    unique_lock<mutex> Guard(Lock);
+    AllDone.wait(Guard, [this] { return NumPending == 0; });
+}
+
+unsigned WorkPool::getNumStolen() {
+    lock_guard<mutex> Guard(Lock);
+    return NumStolen;
+}
+
+bool WorkPool::take(unsigned Worker, Task &T) {
+    bool Stolen = false;
+    {
+        auto &Own = *Queues[Worker];
+        lock_guard<mutex> Guard(Own.Lock);
+        if (!Own.Tasks.empty()) {
+            T = std::move(Own.Tasks.front());
+            Own.Tasks.pop_front();
+        }
+    }
+    // Steal the oldest as well, the tasks start in the order they were dealt.
+    for (unsigned i = 1; !T && i < Queues.size(); i++) {
+        auto &Other = *Queues[(Worker + i) % Queues.size()];
+        lock_guard<mutex> Guard(Other.Lock);
+        if (!Other.Tasks.empty()) {
+            T = std::move(Other.Tasks.front());
+            Other.Tasks.pop_front();
+            Stolen = true;
+        }
+    }
+    if (!T)
+        return false;
+    lock_guard<mutex> Guard(Lock);
+    NumQueued--;
+    NumStolen += Stolen;
+    return true;
+}
+
+void WorkPool::run(unsigned Worker) {
+    while (true) {
+        Task T;
+        if (!take(Worker, T)) {
+            unique_lock<mutex> Guard(Lock);
+            // A task counted but not pushed yet is picked up on the next pass.
+            WorkAvailable.wait(Guard, [this] { return Stopping || NumQueued > 0; });
+            if (Stopping && NumQueued == 0)
+                return;
+            continue;
+        }
+        T();
+        bool Done;
+        {
+            lock_guard<mutex> Guard(Lock);
+            Done = --NumPending == 0;
+        }
+        if (Done)
+            AllDone.notify_all();
+    }
+}
@@ -0,0 +1,66 @@
+//
+//  WorkPool.hpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#ifndef WorkPool_hpp
+#define WorkPool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// WorkPool - A fixed set of worker threads with a task queue each. Tasks are
+/// dealt out round robin, a worker runs its own in the order they were dealt
+/// and, when its queue is empty, steals the oldest task of another worker, so
+/// tasks dealt largest first are started largest first. Tasks of uneven size
+/// even out without one queue every worker contends on.
+class WorkPool {
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Queue {
+        std::mutex Lock;
+        std::deque<Task> Tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> Queues;
+    std::vector<std::thread> Threads;
+
+    std::mutex Lock;
+    std::condition_variable WorkAvailable;
+    std::condition_variable AllDone;
+    /// Tasks queued but not taken, and tasks not yet finished.
+    unsigned NumQueued = 0;
+    unsigned NumPending = 0;
+    unsigned NextQueue = 0;
+    bool Stopping = false;
+    unsigned NumStolen = 0;
+
+    bool take(unsigned Worker, Task &T);
+    void run(unsigned Worker);
+
+public:
+    /// NumThreads of 0 starts one worker per core.
+    explicit WorkPool(unsigned NumThreads = 0);
+    /// Runs the tasks still queued, then joins the workers.
+    ~WorkPool();
+
+    void async(Task T);
+    /// wait - Returns once every task given so far has finished.
+    void wait();
+
+    unsigned getNumThreads() const { return (unsigned)Threads.size(); }
+    /// getNumStolen - Tasks run by a worker other than the one dealt them.
+    unsigned getNumStolen();
+};
+
+#endif /* WorkPool_hpp */
@@ -0,0 +1,155 @@
+//
+//  ast_bench.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "../FlatAST.hpp"
+#include "../Tiered.hpp"
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "llvm/Support/TargetSelect.h"
+
+using namespace std;
+
+// Functions with branches, loops and calls, all of it runnable by tier 0.
+static string GenerateSource(unsigned Functions) {
+    ostringstream Src;
+    for (unsigned i = 0; i < Functions; i++) {
+        Src << "int f" << i << "(int x, int y) {\n"
+            << "    int a = x + y * " << i % 7 + 1 << ";\n"
+            << "    if (a > " << i % 50 << ") {\n"
+            << "        a = a - 1;\n"
+            << "    } else {\n"
+            << "        a = a + 2;\n"
+            << "    }\n"
+            << "    for (int k = 0; k < 8; 1) {\n"
+            << "        a = a + k * (x - y) + (a < k);\n"
+            << "    }\n";
+        if (i)
+            Src << "    return a + f" << i - 1 << "(y, a - " << i % 3 << ");\n";
+        else
+            Src << "    return a;\n";
+        Src << "}\n\n";
+    }
+    return Src.str();
+}
+
+class CollectFunctions : public ItemBuilder {
+public:
+    vector<FunctionAST *> Functions;
+
+    void addFunction(FunctionAST *F) override { Functions.push_back(F); }
+    void addClass(ClassDeclAST *C) override {}
+};
+
+// Counts nodes by kind, every handler falls through to visitNode.
+class KindCounter : public FlatVisitor<KindCounter> {
+public:
+    unsigned long Counts[FK_ExprResult + 1] = {};
+
+    explicit KindCounter(const FlatAST &ast) : FlatVisitor(ast) {}
+
+    void visitNode(unsigned N, const FlatNode &Node) {
+        Counts[Node.Kind]++;
+        FlatVisitor::visitNode(N, Node);
+    }
+};
+
+static double Since(chrono::steady_clock::time_point Start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+}
+
+int main(int argc, const char * argv[]) {
+    unsigned Functions = argc > 1 ? (unsigned)atoi(argv[1]) : 20000;
+    unsigned Rounds = 20;
+
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+
+    string Src = GenerateSource(Functions);
+    CollectFunctions Items;
+    Parser P({ StringRef(Src) }, "ast_bench");
+    TheParser = &P;
+    P.SetItemBuilder(&Items);
+    auto *TopScope = P.NewScope(nullptr);
+    while (P.getCurToken() != tok_eof) {
+        if (P.getCurToken() == tok_colon || P.getCurToken() == tok_right_bracket)
+            P.getNextToken();
+        else
+            P.HandleDefinition(TopScope);
+    }
+
+    // Never started, it only answers the lookups of the analysis.
+    auto JIT = PlayJIT::Create("generic", "", CodeGenOpt::None, [](Module &M, TargetMachine &TM) {});
+    if (!JIT)
+        return 1;
+    TieredRuntime RT(*JIT, nullptr);
+    for (auto *F : Items.Functions)
+        RT.addFunction(F);
+
+    FlatAST Flat;
+    vector<unsigned> Roots;
+    auto Start = chrono::steady_clock::now();
+    for (auto *F : Items.Functions)
+        Roots.push_back(Flat.add(F->getBody()));
+    double FlattenSecs = Since(Start);
+
+    // As TieredRuntime::start runs it, each body flattened on its own first.
+    unsigned long StartRunnable = 0, FlatRunnable = 0;
+    FlatAST Body;
+    FlatInterpretable BodyAnalysis(Body, RT);
+    Start = chrono::steady_clock::now();
+    for (unsigned r = 0; r < Rounds; r++) {
+        for (auto *F : Items.Functions) {
+            Body.clear();
+            StartRunnable += BodyAnalysis.visit(Body.add(F->getBody()));
+        }
+    }
+    double StartSecs = Since(Start);
+
+    FlatInterpretable Analysis(Flat, RT);
+    Start = chrono::steady_clock::now();
+    for (unsigned r = 0; r < Rounds; r++)
+        for (auto Root : Roots)
+            FlatRunnable += Analysis.visit(Root);
+    double FlatSecs = Since(Start);
+
+    if (StartRunnable != FlatRunnable || FlatRunnable != Items.Functions.size() * Rounds) {
+        cerr << "LogError: tier 0 should run every function, " << StartRunnable / Rounds << " and "
+             << FlatRunnable / Rounds << " of " << Items.Functions.size() << endl;
+        return 1;
+    }
+
+    KindCounter Counter(Flat);
+    Start = chrono::steady_clock::now();
+    for (unsigned r = 0; r < Rounds; r++)
+        for (auto Root : Roots)
+            Counter.visit(Root);
+    double CountSecs = Since(Start);
+
+    size_t JSONBytes = 0;
+    Start = chrono::steady_clock::now();
+    for (auto Root : Roots)
+        JSONBytes += Flat.dumpJSON(Root).size();
+    double DumpSecs = Since(Start);
+
+    double Visited = (double)Flat.size() * Rounds;
+    cout << "functions: " << Items.Functions.size() << ", nodes: " << Flat.size() << " x " << Rounds << " rounds, "
+         << FlatRunnable / Rounds << " runnable by tier 0" << endl;
+    cout << "memory: tree arena " << P.getASTContext().getBytesAllocated() << " bytes, flat "
+         << Flat.getMemoryBytes() << " bytes" << endl;
+    cout << "flatten: " << Flat.size() / FlattenSecs / 1e6 << " M nodes/s" << endl;
+    cout << "interpretable, flattened: " << Visited / FlatSecs / 1e6 << " M nodes/s" << endl;
+    cout << "interpretable, flattening each body: " << Visited / StartSecs / 1e6 << " M nodes/s" << endl;
+    cout << "kind count, flat visitor: " << Visited / CountSecs / 1e6 << " M nodes/s, "
+         << Counter.Counts[FK_Binary] / Rounds << " binary" << endl;
+    cout << "JSON dump: " << JSONBytes / DumpSecs / 1e6 << " MB/s" << endl;
+
+    return 0;
+}
@@ -0,0 +1,12 @@
+#!/bin/sh
+
+#  build.sh
+#  play
+#
+#  Created by Jason Hsu on 2026/10/16.
+#  Copyright © 2020 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+
+clang++ -O3 lexer_bench.cpp ../Lexer.cpp `llvm-config --cxxflags --ldflags --libs support --system-libs` -std=c++14 -o lexer_bench
+clang++ -O3 compile_bench.cpp ../Driver.cpp ../Parser.cpp ../Codegen.cpp ../Lexer.cpp ../SourceBuffer.cpp ../Timing.cpp ../JIT.cpp ../Tiered.cpp ../Interpreter.cpp ../CompileCache.cpp ../Incremental.cpp ../Parallel.cpp ../WorkPool.cpp ../Streaming.cpp ../BuildSupport.cpp ../Pipeline.cpp ../Lazy.cpp ../FlatAST.cpp `llvm-config --cxxflags --ldflags --system-libs --libs core mcjit native OrcJIT passes bitreader bitwriter linker` -std=c++14 -o compile_bench
+clang++ -O3 ast_bench.cpp ../Driver.cpp ../Parser.cpp ../Codegen.cpp ../Lexer.cpp ../SourceBuffer.cpp ../Timing.cpp ../JIT.cpp ../Tiered.cpp ../Interpreter.cpp ../CompileCache.cpp ../Incremental.cpp ../Parallel.cpp ../WorkPool.cpp ../Streaming.cpp ../BuildSupport.cpp ../Pipeline.cpp ../Lazy.cpp ../FlatAST.cpp `llvm-config --cxxflags --ldflags --system-libs --libs core mcjit native OrcJIT passes bitreader bitwriter linker` -std=c++14 -o ast_bench
+clang++ -O3 ../*.cpp -DPLAY_CLI `llvm-config --cxxflags --ldflags --system-libs --libs core mcjit native OrcJIT passes bitreader bitwriter linker` -std=c++14 -DPROJECT_DIR=\"`pwd`/../..\" -o playc
@@ -0,0 +1,71 @@
+//
+//  c_kernels.c
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+// The C baselines for kernels.play, written the way the Play versions are.
+// Play's int is 64 bit and its float is a double.
+
+#include <stdlib.h>
+
+long c_loop_sum(long n) {
+    long s = 0;
+    for (long i = 0; i < n; i++)
+        s = s + i * 3;
+    return s;
+}
+
+double c_float_accum(long n) {
+    double s = 0.0;
+    double x = 0.5;
+    for (long i = 0; i < n; i++) {
+        s = s + x * x;
+        x = x + 0.25;
+    }
+    return s;
+}
+
+long c_array_sum(long n) {
+    long *p = malloc(n * sizeof(long));
+    for (long i = 0; i < n; i++)
+        p[i] = i;
+    long s = 0;
+    for (long j = 0; j < n; j++)
+        s = s + p[j];
+    free(p);
+    return s;
+}
+
+struct Counter {
+    long total;
+};
+
+void Counter_add(struct Counter *this, long v) {
+    this->total = this->total + v;
+}
+
+long Counter_get(struct Counter *this) {
+    return this->total;
+}
+
+long c_method_calls(long n) {
+    struct Counter *c = malloc(sizeof(struct Counter));
+    c->total = 0;
+    for (long i = 0; i < n; i++)
+        Counter_add(c, i);
+    return Counter_get(c);
+}
+
+long c_alloc_free(long n) {
+    long s = 0;
+    for (long i = 0; i < n; i++) {
+        long *p = malloc(4 * sizeof(long));
+        p[0] = i;
+        s = s + p[0];
+        free(p);
+    }
+    return s;
+}
@@ -0,0 +1,252 @@
+//
+//  compile_bench.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "../Driver.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Workloads, each stressing one part of the front end. Scale 1 is a few
+// thousand functions, big enough for the rates to settle.
+
+// Many small functions with a branch, a loop and a call each.
+static string GenerateFunctions(unsigned Scale) {
+    ostringstream Src;
+    unsigned N = 2000 * Scale;
+    for (unsigned i = 0; i < N; i++) {
+        Src << "int f" << i << "(int x, int y) {\n"
+            << "    int a = x + y * " << i % 7 + 1 << ";\n"
+            << "    if (a > " << i % 50 << ") {\n"
+            << "        a = a - 1;\n"
+            << "    } else {\n"
+            << "        a = a + 2;\n"
+            << "    }\n"
+            << "    for (int k = 0; k < 8; 1) {\n"
+            << "        a = a + k;\n"
+            << "    }\n";
+        if (i)
+            Src << "    return a + f" << i - 1 << "(y, a);\n";
+        else
+            Src << "    return a;\n";
+        Src << "}\n\n";
+    }
+    return Src.str();
+}
+
+static void GenerateNestedIf(ostringstream &Src, unsigned Depth, unsigned Level) {
+    string Ind(4 * (Level + 1), ' ');
+    if (Level == Depth) {
+        Src << Ind << "x = x + 1;\n";
+        return;
+    }
+    Src << Ind << "if (x > " << Level << ") {\n";
+    GenerateNestedIf(Src, Depth, Level + 1);
+    Src << Ind << "} else {\n"
+        << Ind << "    x = x - " << Level << ";\n"
+        << Ind << "}\n";
+}
+
+// Deeply nested blocks, each with its own scope.
+static string GenerateNesting(unsigned Scale) {
+    ostringstream Src;
+    unsigned N = 50 * Scale;
+    for (unsigned i = 0; i < N; i++) {
+        Src << "int n" << i << "(int x) {\n";
+        GenerateNestedIf(Src, 32, 0);
+        Src << "    return x;\n"
+            << "}\n\n";
+    }
+    return Src.str();
+}
+
+// Classes with members and methods, and functions using them.
+static string GenerateClasses(unsigned Scale) {
+    ostringstream Src;
+    unsigned N = 200 * Scale;
+    for (unsigned i = 0; i < N; i++) {
+        Src << "class C" << i << " {\n"
+            << "    int a;\n"
+            << "    float b;\n"
+            << "    bool c;\n"
+            << "\n"
+            << "    int getA() {\n"
+            << "        return this.a;\n"
+            << "    }\n"
+            << "\n"
+            << "    void setA(int v) {\n"
+            << "        this.a = v;\n"
+            << "    }\n"
+            << "}\n\n"
+            << "int useC" << i << "(int v) {\n"
+            << "    C" << i << " o = C" << i << "();\n"
+            << "    o.setA(v);\n"
+            << "    o.b = 2.0;\n"
+            << "    return o.getA();\n"
+            << "}\n\n";
+    }
+    return Src.str();
+}
+
+// Long arithmetic expressions mixing precedences.
+static string GenerateExpressions(unsigned Scale) {
+    ostringstream Src;
+    unsigned N = 100 * Scale;
+    const char *Ops[] = { " + ", " * ", " - ", " * " };
+    for (unsigned i = 0; i < N; i++) {
+        Src << "int e" << i << "(int x, int y) {\n"
+            << "    return x";
+        for (unsigned t = 0; t < 256; t++) {
+            Src << Ops[t % 4];
+            if (t % 3 == 0)
+                Src << "y";
+            else if (t % 3 == 1)
+                Src << "x";
+            else
+                Src << t % 10 + 1;
+        }
+        Src << ";\n"
+            << "}\n\n";
+    }
+    return Src.str();
+}
+
+struct Workload {
+    const char *Name;
+    function<string(unsigned)> Generate;
+};
+
+struct Result {
+    string Workload;
+    CompileStats Stats;
+    double TotalSecs = 0;
+};
+
+static double Phase(const CompileStats &S, const char *Name) {
+    auto I = S.PhaseSeconds.find(Name);
+    return I == S.PhaseSeconds.end() ? 0 : I->second;
+}
+
+static double Rate(double Count, double Secs) {
+    return Secs > 0 ? Count / Secs : 0;
+}
+
+static void WriteJSON(ostream &OS, const vector<Result> &Results, unsigned Scale, unsigned OptLevel) {
+    OS << "{\n  \"scale\": " << Scale << ",\n  \"opt_level\": " << OptLevel << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < Results.size(); i++) {
+        auto &R = Results[i];
+        auto &S = R.Stats;
+        OS << "    {\"workload\": \"" << R.Workload << "\""
+           << ", \"source_bytes\": " << S.SourceBytes
+           << ", \"tokens\": " << S.Tokens
+           << ", \"ast_nodes\": " << S.ASTNodes
+           << ", \"ir_instructions\": " << S.IRInstructions
+           << ", \"object_bytes\": " << S.ObjectBytes
+           << ", \"total_seconds\": " << R.TotalSecs
+           << ", \"phase_seconds\": {";
+        bool First = true;
+        for (auto &P : S.PhaseSeconds) {
+            OS << (First ? "" : ", ") << "\"" << P.first << "\": " << P.second;
+            First = false;
+        }
+        OS << "}"
+           << ", \"tokens_per_second\": " << Rate(S.Tokens, Phase(S, "parse"))
+           << ", \"ast_nodes_per_second\": " << Rate(S.ASTNodes, Phase(S, "parse"))
+           << ", \"ir_instructions_per_second\": " << Rate(S.IRInstructions, Phase(S, "irgen"))
+           << ", \"object_bytes_per_second\": " << Rate(S.ObjectBytes, Phase(S, "emit"))
+           << "}" << (i + 1 < Results.size() ? "," : "") << "\n";
+    }
+    OS << "  ]\n}\n";
+}
+
+int main(int argc, const char * argv[]) {
+    unsigned Scale = 1;
+    unsigned Repeat = 3;
+    string OptLevel = "0";
+    string JSONPath = "compile_bench.json";
+    string Only;
+    for (int i = 1; i < argc; i++) {
+        string Arg = argv[i];
+        if (Arg == "-scale" && i + 1 < argc)
+            Scale = (unsigned)atoi(argv[++i]);
+        else if (Arg == "-repeat" && i + 1 < argc)
+            Repeat = (unsigned)atoi(argv[++i]);
+        else if (Arg.size() == 3 && Arg.compare(0, 2, "-O") == 0)
+            OptLevel = Arg.substr(2);
+        else if (Arg == "-json" && i + 1 < argc)
+            JSONPath = argv[++i];
+        else if (Arg == "-only" && i + 1 < argc)
+            Only = argv[++i];
+        else {
+            cerr << "usage: compile_bench [-scale N] [-repeat N] [-O0..-O3] [-json file] [-only workload]" << endl;
+            return 1;
+        }
+    }
+    if (!Scale || !Repeat) {
+        cerr << "LogError: -scale and -repeat must be positive" << endl;
+        return 1;
+    }
+
+    vector<Workload> Workloads = {
+        {"functions", GenerateFunctions},
+        {"nesting", GenerateNesting},
+        {"classes", GenerateClasses},
+        {"expressions", GenerateExpressions},
+    };
+
+    vector<Result> Results;
+    for (auto &W : Workloads) {
+        if (!Only.empty() && Only != W.Name)
+            continue;
+
+        string Path = string("bench_") + W.Name + ".play";
+        {
+            ofstream Out(Path);
+            Out << W.Generate(Scale);
+        }
+
+        // Keep the fastest run, the others only add noise.
+        Result Best;
+        for (unsigned r = 0; r < Repeat; r++) {
+            auto Src = SourceBuffer::getFile(Path);
+            if (!Src)
+                return 1;
+            map<string, string> Opts = {{"O", OptLevel}, {"out", Path + ".o"}};
+            Result R;
+            R.Workload = W.Name;
+            auto Start = chrono::steady_clock::now();
+            if (compile(Path, *Src, Opts, &R.Stats))
+                return 1;
+            R.TotalSecs = chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+            if (r == 0 || R.TotalSecs < Best.TotalSecs)
+                Best = R;
+        }
+        Results.push_back(Best);
+    }
+
+    cout << "\n### Compile Throughput (-O" << OptLevel << ", scale " << Scale << ") ###" << endl;
+    for (auto &R : Results) {
+        auto &S = R.Stats;
+        cout << R.Workload << ": " << R.TotalSecs * 1000 << " ms, "
+             << Rate(S.Tokens, Phase(S, "parse")) / 1e6 << " M tokens/s, "
+             << Rate(S.ASTNodes, Phase(S, "parse")) / 1e6 << " M nodes/s, "
+             << Rate(S.IRInstructions, Phase(S, "irgen")) / 1e6 << " M insts/s, "
+             << Rate(S.ObjectBytes, Phase(S, "emit")) / 1e6 << " MB/s object" << endl;
+    }
+
+    ofstream JSON(JSONPath);
+    WriteJSON(JSON, Results, Scale, (unsigned)atoi(OptLevel.c_str()));
+    cout << "Wrote " << JSONPath << endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+//
+//  lexer_bench.cpp
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2020 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+#include "../Lexer.hpp"
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// The if-chain getNextToken used before the keyword table, kept as the baseline.
+static Token getKeywordTokenChain(const string &IdentifierStr) {
+    if (IdentifierStr == "extern") return tok_extern;
+    if (IdentifierStr == "if") return tok_if;
+    if (IdentifierStr == "then") return tok_then;
+    if (IdentifierStr == "else") return tok_else;
+    if (IdentifierStr == "for") return tok_for;
+    if (IdentifierStr == "in") return tok_in;
+    if (IdentifierStr == "unary") return tok_unary;
+    if (IdentifierStr == "binary") return tok_binary;
+    if (IdentifierStr == "var") return tok_var;
+    if (IdentifierStr == "void") return tok_type_void;
+    if (IdentifierStr == "bool") return tok_type_bool;
+    if (IdentifierStr == "int") return tok_type_int;
+    if (IdentifierStr == "float") return tok_type_float;
+    if (IdentifierStr == "string") return tok_type_string;
+    if (IdentifierStr == "class") return tok_class;
+    if (IdentifierStr == "new") return tok_new;
+    if (IdentifierStr == "delete") return tok_del;
+    if (IdentifierStr == "return") return tok_ret;
+    return tok_identifier;
+}
+
+// Mostly identifiers with a keyword now and then, like our generated sources.
+static string GenerateSource(unsigned Lines) {
+    string Src;
+    for (unsigned i = 0; i < Lines; i++) {
+        Src += "int value" + to_string(i) + " = compute" + to_string(i % 97)
+             + "(input" + to_string(i % 13) + ", offset, scale) + bias" + to_string(i % 7) + ";\n";
+        if (i % 8 == 0)
+            Src += "return value" + to_string(i) + ";\n";
+    }
+    return Src;
+}
+
+static double Since(chrono::steady_clock::time_point Start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - Start).count();
+}
+
+int main(int argc, const char * argv[]) {
+    unsigned Lines = argc > 1 ? (unsigned)atoi(argv[1]) : 200000;
+    unsigned Rounds = 20;
+
+    string Src = GenerateSource(Lines);
+
+    vector<string> Words;
+    string Word;
+    for (char C : Src) {
+        if (isalnum(C)) {
+            Word += C;
+        } else if (!Word.empty()) {
+            if (isalpha(Word[0]))
+                Words.push_back(Word);
+            Word.clear();
+        }
+    }
+
+    volatile long Sink = 0;
+
+    auto Start = chrono::steady_clock::now();
+    for (unsigned r = 0; r < Rounds; r++)
+        for (auto &W : Words)
+            Sink += getKeywordTokenChain(W);
+    double ChainSecs = Since(Start);
+
+    Start = chrono::steady_clock::now();
+    for (unsigned r = 0; r < Rounds; r++)
+        for (auto &W : Words)
+            Sink += getKeywordToken(W.data(), W.size());
+    double TableSecs = Since(Start);
+
+    double Classified = (double)Words.size() * Rounds;
+    cout << "identifiers: " << Words.size() << " x " << Rounds << " rounds" << endl;
+    cout << "keyword chain: " << Classified / ChainSecs / 1e6 << " M ids/s" << endl;
+    cout << "keyword table: " << Classified / TableSecs / 1e6 << " M ids/s" << endl;
+    cout << "speedup: " << ChainSecs / TableSecs << "x" << endl;
+
+    Lexer L(Src);
+    unsigned long Ids = 0;
+    Start = chrono::steady_clock::now();
+    for (Token T = L.getNextToken(); T != tok_eof; T = L.getNextToken()) {
+        if (T == tok_identifier)
+            Ids++;
+    }
+    double LexSecs = Since(Start);
+    cout << "lexer: " << Ids / LexSecs / 1e6 << " M ids/s, " << Src.size() / LexSecs / 1e6 << " MB/s" << endl;
+
+    // Same scan with identifiers interned, the way the parser runs it.
+    SymbolTable Symbols;
+    Lexer IL(Src, &Symbols);
+    Start = chrono::steady_clock::now();
+    for (Token T = IL.getNextToken(); T != tok_eof; T = IL.getNextToken())
+        ;
+    double InternSecs = Since(Start);
+    cout << "lexer + interning: " << Ids / InternSecs / 1e6 << " M ids/s, " << Symbols.size() << " symbols" << endl;
+
+    return (int)(Sink & 0);
+}
@@ -0,0 +1,98 @@
+//
+//  runtime_bench.c
+//  play
+//
+//  Created by Jason Hsu on 2026/10/16.
+//  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+//
+
+// Times the kernels compiled by play against the same kernels compiled by cc,
+// see runtime_bench.sh. Both are called through pointers so neither is
+// inlined into the timing loop.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// kernels.play
+extern long loop_sum(long n);
+extern double float_accum(long n);
+extern long array_sum(long n);
+extern long method_calls(long n);
+extern long alloc_free(long n);
+
+// c_kernels.c
+extern long c_loop_sum(long n);
+extern double c_float_accum(long n);
+extern long c_array_sum(long n);
+extern long c_method_calls(long n);
+extern long c_alloc_free(long n);
+
+struct Kernel {
+    const char *Name;
+    long N;
+    long (*Play)(long);
+    long (*C)(long);
+    double (*PlayF)(long);
+    double (*CF)(long);
+};
+
+static struct Kernel Kernels[] = {
+    {"loop_sum", 100000000, loop_sum, c_loop_sum, 0, 0},
+    {"float_accum", 100000000, 0, 0, float_accum, c_float_accum},
+    {"array_sum", 10000000, array_sum, c_array_sum, 0, 0},
+    {"method_calls", 100000000, method_calls, c_method_calls, 0, 0},
+    {"alloc_free", 10000000, alloc_free, c_alloc_free, 0, 0},
+};
+
+static double Now(void) {
+    struct timespec T;
+    clock_gettime(CLOCK_MONOTONIC, &T);
+    return T.tv_sec + T.tv_nsec / 1e9;
+}
+
+// Best of Repeat runs, the result of the last one goes to Result.
+static double Run(long (*F)(long), double (*FF)(long), long N, int Repeat, double *Result) {
+    double Best = 0;
+    for (int r = 0; r < Repeat; r++) {
+        double Start = Now();
+        *Result = F ? (double)F(N) : FF(N);
+        double Secs = Now() - Start;
+        if (r == 0 || Secs < Best)
+            Best = Secs;
+    }
+    return Best;
+}
+
+int main(int argc, const char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: runtime_bench <opt-level> <csv-file> [repeat]\n");
+        return 1;
+    }
+    const char *OptLevel = argv[1];
+    int Repeat = argc > 3 ? atoi(argv[3]) : 5;
+
+    FILE *CSV = fopen(argv[2], "a");
+    if (!CSV) {
+        fprintf(stderr, "LogError: can't open %s\n", argv[2]);
+        return 1;
+    }
+
+    int Failed = 0;
+    printf("### -O%s ###\n", OptLevel);
+    for (size_t i = 0; i < sizeof(Kernels) / sizeof(Kernels[0]); i++) {
+        struct Kernel *K = &Kernels[i];
+        double PlayResult, CResult;
+        double PlaySecs = Run(K->Play, K->PlayF, K->N, Repeat, &PlayResult);
+        double CSecs = Run(K->C, K->CF, K->N, Repeat, &CResult);
+        int Match = PlayResult == CResult;
+        Failed |= !Match;
+        printf("%-14s play %8.3f ms   c %8.3f ms   play/c %6.2fx%s\n",
+               K->Name, PlaySecs * 1e3, CSecs * 1e3, PlaySecs / CSecs, Match ? "" : "   RESULT MISMATCH");
+        fprintf(CSV, "%s,%s,%ld,%.9f,%.9f,%.4f,%d\n",
+                OptLevel, K->Name, K->N, PlaySecs, CSecs, PlaySecs / CSecs, Match);
+    }
+    fclose(CSV);
+    return Failed;
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+
+#  runtime_bench.sh
+#  play
+#
+#  Created by Jason Hsu on 2026/10/16.
+#  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+
+# Compiles kernels.play with playc and c_kernels.c with cc at each -O level,
+# links both into runtime_bench and runs it. Results go to runtime_bench.csv.
+# Usage: ./runtime_bench.sh [repeat]
+
+set -e
+cd `dirname $0`
+
+REPEAT=${1:-5}
+CSV=runtime_bench.csv
+echo "opt,kernel,n,play_seconds,c_seconds,play_over_c,match" > $CSV
+
+for O in 0 1 2 3; do
+    ./playc -O$O -o kernels_O$O.o kernels.play > /dev/null
+    xcrun cc -O$O -c c_kernels.c -o c_kernels_O$O.o
+    xcrun cc -O2 runtime_bench.c kernels_O$O.o c_kernels_O$O.o -o runtime_bench_O$O
+    ./runtime_bench_O$O $O $CSV $REPEAT
+done
+
+echo "Wrote $CSV"
@@ -9,4 +9,6 @@
 export PATH=/usr/local/Cellar/llvm/9.0.0/bin:$PATH
 export PROJECT_DIR=`pwd`/..
 
-clang++ -g -O3 *.cpp `llvm-config --cxxflags --ldflags --system-libs --libs core mcjit native OrcJIT` -std=c++14 -DPROJECT_DIR=\"`pwd`/..\" -o play
+# play runs the test selected by TEST in cli.cpp, playc is the command line compiler.
+clang++ -g -O3 *.cpp `llvm-config --cxxflags --ldflags --system-libs --libs core mcjit native OrcJIT passes bitreader bitwriter linker` -std=c++14 -DPROJECT_DIR=\"`pwd`/..\" -o play
+clang++ -g -O3 *.cpp `llvm-config --cxxflags --ldflags --system-libs --libs core mcjit native OrcJIT passes bitreader bitwriter linker` -std=c++14 -DPROJECT_DIR=\"`pwd`/..\" -DPLAY_CLI -o playc
@@ -7,11 +7,13 @@
 //
 
 #include "Driver.hpp"
+#include "Server.hpp"
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <filesystem>
 
+#include "llvm/Support/FileSystem.h"
+
 //#define TEST "def"
 //#define TEST "extern"
 //#define TEST "constant"
@@ -24,7 +26,9 @@
 //#define TEST "var"
 //#define TEST "var_init"
 //#define TEST "var_assign"
+#ifndef PLAY_CLI // -DPLAY_CLI builds the plain command line compiler, as the benchmarks do
 #define TEST "ifcond"
+#endif
 //#define TEST "forloop"
 //#define TEST "formula"
 //#define TEST "compound"
@@ -37,10 +41,81 @@
 //#define TEST "int_pointer_arg"
 //#define TEST "delete_ptr"
 
+static void ParseArgs(int argc, const char * argv[], std::vector<std::string> &inputs, std::map<std::string, std::string> &opts) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.size() == 3 && arg.compare(0, 2, "-O") == 0 && arg[2] >= '0' && arg[2] <= '3') {
+            opts["O"] = arg.substr(2);
+        } else if (arg == "-march=native") {
+            opts["cpu"] = "native";
+        } else if (arg.compare(0, 6, "-mcpu=") == 0) {
+            opts["cpu"] = arg.substr(6);
+        } else if (arg.compare(0, 7, "-mattr=") == 0) {
+            opts["features"] = arg.substr(7);
+        } else if (arg.compare(0, 7, "-trace=") == 0) {
+            opts["trace"] = arg.substr(7);
+        } else if (arg.compare(0, 12, "-trace-file=") == 0) {
+            opts["trace-file"] = arg.substr(12);
+        } else if (arg == "-time-report") {
+            opts["time-report"] = "1";
+        } else if (arg == "-time-trace") {
+            opts["time-trace"] = "";
+        } else if (arg.compare(0, 12, "-time-trace=") == 0) {
+            opts["time-trace"] = arg.substr(12);
+        } else if (arg == "--jit" || arg == "-jit") {
+            opts["jit"] = "1";
+        } else if (arg == "--tiered" || arg == "-tiered") {
+            opts["tiered"] = "1";
+        } else if (arg == "--repl" || arg == "-repl") {
+            opts["repl"] = "1";
+        } else if (arg == "--daemon" || arg == "--use-server" || arg == "--stop-server") {
+            opts[arg.substr(2)] = getDefaultSocketPath();
+        } else if (arg.compare(0, 9, "--daemon=") == 0 || arg.compare(0, 13, "--use-server=") == 0 ||
+                   arg.compare(0, 14, "--stop-server=") == 0) {
+            auto eq = arg.find('=');
+            opts[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+        } else if (arg == "--cache") {
+            opts["cache"] = "";
+        } else if (arg.compare(0, 8, "--cache=") == 0) {
+            opts["cache"] = arg.substr(8);
+        } else if (arg.compare(0, 13, "--cache-size=") == 0) {
+            opts["cache-size"] = arg.substr(13);
+        } else if (arg == "--incremental") {
+            opts["incremental"] = "";
+        } else if (arg.compare(0, 14, "--incremental=") == 0) {
+            opts["incremental"] = arg.substr(14);
+        } else if (arg == "--stream") {
+            opts["stream"] = "1";
+        } else if (arg == "--lazy") {
+            opts["lazy"] = "1";
+        } else if (arg == "--pipeline") {
+            opts["pipeline"] = "1";
+        } else if (arg == "-j") {
+            opts["threads"] = "0";
+        } else if (arg.size() > 2 && arg.compare(0, 2, "-j") == 0) {
+            opts["threads"] = arg.substr(2);
+        } else if (arg.compare(0, 10, "--threads=") == 0) {
+            opts["threads"] = arg.substr(10);
+        } else if (arg.compare(0, 7, "--jobs=") == 0) {
+            opts["jobs"] = arg.substr(7);
+        } else if (arg == "-stats") {
+            opts["stats"] = "1";
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts["out"] = argv[++i];
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+}
+
 #ifdef TEST
 
 int main(int argc, const char * argv[]) {
 
+    std::vector<std::string> inputs;
+    std::map<std::string, std::string> cliOpts;
+    ParseArgs(argc, argv, inputs, cliOpts);
+
     std::string testsDir = std::string(PROJECT_DIR) + "/play/tests";
     for (const auto & entry : std::__fs::filesystem::directory_iterator(testsDir)) {
 
@@ -49,22 +124,17 @@ int main(int argc, const char * argv[]) {
 
         std::cout << "📟 start building " << entry.path().filename() << std::endl;
 
-        std::string src;
-        std::ifstream t(entry.path());
+        auto src = SourceBuffer::getFile(entry.path().string());
+        if (!src)
+            return 1;
 
-        t.seekg(0, std::ios::end);
-        src.reserve(t.tellg());
-        t.seekg(0, std::ios::beg);
-
-        src.assign((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-
-        std::map<std::string, std::string> opts;
+        std::map<std::string, std::string> opts = cliOpts;
         opts["jit"] = "0";
         opts["out"] = testsDir + "/" + TEST + ".o";
         opts["obj"] = std::string(TEST) != "exec" ? "1" : "0";
 
         std::string module = std::string(filename);
-        compile(module, src, opts);
+        compile(module, *src, opts);
     }
     return 0;
 }
@@ -72,26 +142,41 @@ int main(int argc, const char * argv[]) {
 #else
 
 int main(int argc, const char * argv[]) {
-    std::string src;
-    if (argc == 0) {
-        while(true) {
-            char c = getchar();
-            if (c == EOF)
-                break;
-            src += c;
+    std::vector<std::string> inputs;
+    std::map<std::string, std::string> opts;
+    ParseArgs(argc, argv, inputs, opts);
+    if (opts["repl"] == "1")
+        return repl(opts);
+    if (opts.count("daemon"))
+        return serve(opts["daemon"]);
+    if (opts.count("stop-server"))
+        return stopServer(opts["stop-server"]) ? 0 : 1;
+
+    // Several files, or a directory of them, are compiled side by side.
+    if (inputs.size() > 1 || (inputs.size() == 1 && llvm::sys::fs::is_directory(inputs[0]))) {
+        if (opts["jit"] == "1" || opts["tiered"] == "1") {
+            std::cerr << "LogError: --jit and --tiered run a single file" << std::endl;
+            return 1;
         }
-    } else {
-        std::ifstream t(argv[0]);
-
-        t.seekg(0, std::ios::end);
-        src.reserve(t.tellg());
-        t.seekg(0, std::ios::beg);
-
-        src.assign((std::istreambuf_iterator<char>(t)),
-                    std::istreambuf_iterator<char>());
+        return compileBatch(inputs, opts);
     }
-    compile("stdin", src);
-    return 0;
+    std::string input = inputs.empty() ? "" : inputs[0];
+
+    // Object files only, a server can't run the program here. Without a
+    // server the compile just happens in this process.
+    if (opts.count("use-server") && !input.empty() && input != "-" && opts["jit"] != "1" && opts["tiered"] != "1") {
+        std::string server = opts["use-server"];
+        opts.erase("use-server");
+        int status;
+        if (compileOnServer(server, input, opts, status))
+            return status;
+    }
+
+    auto src = SourceBuffer::getFile(input.empty() ? "-" : input);
+    if (!src)
+        return 1;
+    std::string module = input.empty() ? "stdin" : input;
+    return compile(module, *src, opts);
 }
 
 #endif
@@ -0,0 +1,20 @@
+#!/bin/sh
+
+#  test_batch.sh
+#  play
+#
+#  Created by Jason Hsu on 2026/10/17.
+#  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+
+# A broken file fails on its own, the rest of the batch is still compiled.
+rm -rf batch.out
+../playc batch -o batch.out > batch.log 2>&1
+Ret=$?
+cat batch.log
+xcrun cc call_triple.c batch.out/triple.o
+./a.out
+if [[ "$?" == "42" && "$Ret" == "1" && ! -e batch.out/broken.o ]] && grep -q "Compiled 2 of 3 files" batch.log; then
+    echo "Pass"
+else
+    echo "Fail"
+fi
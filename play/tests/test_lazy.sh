@@ -0,0 +1,17 @@
+#!/bin/sh
+
+#  test_lazy.sh
+#  play
+#
+#  Created by Jason Hsu on 2026/10/17.
+#  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+
+# fill is called only from a method returning a pointer, it must still be compiled.
+../playc lazy_method.play --lazy -o lazy_method.o
+xcrun cc lazy_method.o
+./a.out
+if [[ "$?" == "42" ]]; then
+    echo "Pass"
+else
+    echo "Fail"
+fi
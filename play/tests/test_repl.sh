@@ -0,0 +1,17 @@
+#!/bin/sh
+
+#  test_repl.sh
+#  play
+#
+#  Created by Jason Hsu on 2026/10/17.
+#  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+
+# Returned values print as their own type, not as the bits of an int.
+Out=$(printf 'return 2.5;\nreturn 1 < 2;\nreturn 42;\n' | ../playc --repl 2>/dev/null)
+if [[ "$Out" == "=> 2.5
+=> true
+=> 42" ]]; then
+    echo "Pass"
+else
+    echo "Fail"
+fi
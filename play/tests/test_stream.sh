@@ -0,0 +1,20 @@
+#!/bin/sh
+
+#  test_stream.sh
+#  play
+#
+#  Created by Jason Hsu on 2026/10/17.
+#  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+
+# The tests with classes, compiled chunk by chunk.
+Result="Pass"
+for Test in class_member class_method lazy_method; do
+    ../playc $Test.play --stream -o $Test.stream.o
+    xcrun cc $Test.stream.o -o $Test.stream
+    ./$Test.stream
+    if [[ "$?" != "42" ]]; then
+        echo "$Test failed"
+        Result="Fail"
+    fi
+done
+echo $Result
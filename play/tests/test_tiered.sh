@@ -0,0 +1,18 @@
+#!/bin/sh
+
+#  test_tiered.sh
+#  play
+#
+#  Created by Jason Hsu on 2026/10/17.
+#  Copyright © 2026 Jason Hsu<tuoxie007@gmail.com>. All rights reserved.
+
+# Pointers and classes are compiled up front, the rest is interpreted.
+Result="Pass"
+for Test in int_pointer_arg class_member class_method lazy_method call; do
+    ../playc $Test.play --tiered
+    if [[ "$?" != "42" ]]; then
+        echo "$Test failed"
+        Result="Fail"
+    fi
+done
+echo $Result